@@ -0,0 +1,36 @@
+#ifndef DEVICES_BIO_H
+#define DEVICES_BIO_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+
+typedef void bio_done_func(struct bio*);
+
+/* A block I/O request: CNT sectors starting at SECTOR, moving
+   between the device and BUFFER.  Submit it with block_submit();
+   when it completes, DONE is called (in interrupt context, so it
+   must not sleep) and then any thread waiting in bio_wait() is
+   woken. */
+struct bio {
+  struct list_elem elem;     /* Element in a request queue. */
+  struct list_elem fifo_elem; /* Element in an I/O scheduler FIFO. */
+  struct block* block;       /* Device the request is queued on. */
+  block_sector_t sector;     /* First sector. */
+  size_t cnt;                /* Number of sectors. */
+  void* buffer;              /* CNT * BLOCK_SECTOR_SIZE bytes of data. */
+  bool write;                /* True to write, false to read. */
+  bio_done_func* done;       /* Called last on completion, if nonnull. */
+  void* aux;                 /* For DONE's use. */
+  void* driver_aux;          /* For the driver's use. */
+  struct semaphore complete; /* Up'd on completion. */
+  int64_t submit_time;       /* Timer tick when submitted. */
+  uint64_t submit_cycles;    /* Time-stamp counter when submitted. */
+};
+
+void bio_init(struct bio*, block_sector_t, size_t cnt, void* buffer, bool write);
+void bio_wait(struct bio*);
+
+#endif /* devices/bio.h */
@@ -1,10 +1,19 @@
 #include "devices/block.h"
+#include <blktrace.h>
 #include <list.h>
 #include <string.h>
 #include <stdio.h>
+#include "devices/bio.h"
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
+/* Number of buckets in a latency histogram, one per power of 2
+   of CPU cycles. */
+#define LATENCY_BUCKETS 64
+
 /* A block device. */
 struct block {
   struct list_elem list_elem; /* Element in all_blocks. */
@@ -18,15 +27,54 @@ struct block {
 
   unsigned long long read_cnt;  /* Number of sectors read. */
   unsigned long long write_cnt; /* Number of sectors written. */
+
+  /* Requests for asynchronous drivers.  Only touched with
+     interrupts off. */
+  struct iosched_queue queue; /* Requests not yet given to the driver. */
+  struct bio* active;         /* Request the driver is working on, or null. */
+
+  /* Queued requests for consecutive sectors are merged into one
+     request for the driver, copying their data through a buffer
+     of MERGE_SECTORS sectors. */
+  struct bio merged;       /* The merged request. */
+  struct list merged_bios; /* Requests that make up MERGED. */
+  uint8_t* merge_buf;      /* MERGED's data, or null if merging is off. */
+
+  /* I/O scheduler statistics. */
+  unsigned long long queued_cnt; /* Number of requests queued. */
+  unsigned long long depth_sum;  /* Sum of the queue depths they saw. */
+  unsigned long long merge_cnt;  /* Number merged into an earlier one. */
+  int64_t max_latency;           /* Longest time to completion, in ticks. */
+
+  /* Number of requests completed in 2**i to 2**(i+1) - 1 cycles,
+     for each bucket i. */
+  unsigned long long latency_hist[LATENCY_BUCKETS];
 };
 
+/* Maximum number of sectors in a merged request. */
+#define MERGE_SECTORS 64
+
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER(all_blocks);
 
 /* The block block assigned to each Pintos role. */
 static struct block* block_by_role[BLOCK_ROLE_CNT];
 
+/* Trace of recently completed requests, if enabled.  When the
+   ring is full, the oldest entry is overwritten.  Only touched
+   with interrupts off. */
+static bool trace_enabled;
+static struct blktrace_entry trace[BLOCK_TRACE_CNT];
+static size_t trace_head;  /* Index of the next entry to write. */
+static size_t trace_used;  /* Number of entries not yet read. */
+static unsigned long long trace_lost; /* Entries overwritten before they were read. */
+
 static struct block* list_elem_to_block(struct list_elem*);
+static void record_completion(struct block*, const struct bio*, uint64_t now);
+static int log2_bucket(uint64_t);
+static void start_next(struct block*);
+static struct bio* merge(struct block*, struct bio*);
+static void merge_add(struct block*, struct bio*);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -95,9 +143,7 @@ static void check_sector(struct block* block, block_sector_t sector) {
    Internally synchronizes accesses to block devices, so external
    per-block device locking is unneeded. */
 void block_read(struct block* block, block_sector_t sector, void* buffer) {
-  check_sector(block, sector);
-  block->ops->read(block->aux, sector, buffer);
-  block->read_cnt++;
+  block_read_multiple(block, sector, 1, buffer);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -106,10 +152,278 @@ void block_read(struct block* block, block_sector_t sector, void* buffer) {
    Internally synchronizes accesses to block devices, so external
    per-block device locking is unneeded. */
 void block_write(struct block* block, block_sector_t sector, const void* buffer) {
-  check_sector(block, sector);
-  ASSERT(block->type != BLOCK_FOREIGN);
-  block->ops->write(block->aux, sector, buffer);
-  block->write_cnt++;
+  block_write_multiple(block, sector, 1, buffer);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes, and waits for the read to finish. */
+void block_read_multiple(struct block* block, block_sector_t sector, size_t cnt, void* buffer) {
+  struct bio bio;
+
+  if (cnt == 0)
+    return;
+  bio_init(&bio, sector, cnt, buffer, false);
+  block_submit(block, &bio);
+  bio_wait(&bio);
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving all
+   of the data. */
+void block_write_multiple(struct block* block, block_sector_t sector, size_t cnt,
+                          const void* buffer) {
+  struct bio bio;
+
+  if (cnt == 0)
+    return;
+  bio_init(&bio, sector, cnt, (void*)buffer, true);
+  block_submit(block, &bio);
+  bio_wait(&bio);
+}
+
+/* Initializes BIO as a request to read (or, if WRITE is true,
+   write) CNT sectors starting at SECTOR into (or from) BUFFER,
+   with no completion callback. */
+void bio_init(struct bio* bio, block_sector_t sector, size_t cnt, void* buffer, bool write) {
+  ASSERT(cnt > 0);
+
+  bio->block = NULL;
+  bio->sector = sector;
+  bio->cnt = cnt;
+  bio->buffer = buffer;
+  bio->write = write;
+  bio->done = NULL;
+  bio->aux = NULL;
+  bio->driver_aux = NULL;
+  sema_init(&bio->complete, 0);
+  bio->submit_time = 0;
+  bio->submit_cycles = 0;
+}
+
+/* Waits for BIO, which must have been submitted, to complete. */
+void bio_wait(struct bio* bio) { sema_down(&bio->complete); }
+
+/* Submits BIO to BLOCK.  If BLOCK's driver is asynchronous, the
+   request is queued and this returns at once; otherwise, the
+   transfer is carried out before returning.  Either way, BIO's
+   completion is signaled as described for struct bio. */
+void block_submit(struct block* block, struct bio* bio) {
+  const struct block_operations* ops = block->ops;
+  enum intr_level old_level;
+
+  check_sector(block, bio->sector);
+  check_sector(block, bio->sector + bio->cnt - 1);
+  ASSERT(!bio->write || block->type != BLOCK_FOREIGN);
+
+  bio->block = block;
+  bio->submit_time = timer_ticks();
+  bio->submit_cycles = timer_cycles();
+
+  /* Drivers may submit from interrupt context, so the counters
+     are updated with interrupts off. */
+  old_level = intr_disable();
+  if (bio->write)
+    block->write_cnt += bio->cnt;
+  else
+    block->read_cnt += bio->cnt;
+  intr_set_level(old_level);
+
+  if (ops->submit != NULL)
+    ops->submit(block->aux, bio);
+  else if (ops->start != NULL) {
+    old_level = intr_disable();
+    iosched_add(&block->queue, bio);
+    block->queued_cnt++;
+    block->depth_sum += block->queue.cnt;
+    start_next(block);
+    intr_set_level(old_level);
+  } else {
+    /* Synchronous driver. */
+    uint8_t* p = bio->buffer;
+    size_t i;
+
+    if (bio->write && ops->write_multiple != NULL)
+      ops->write_multiple(block->aux, bio->sector, bio->cnt, p);
+    else if (!bio->write && ops->read_multiple != NULL)
+      ops->read_multiple(block->aux, bio->sector, bio->cnt, p);
+    else
+      for (i = 0; i < bio->cnt; i++, p += BLOCK_SECTOR_SIZE) {
+        if (bio->write)
+          ops->write(block->aux, bio->sector + i, p);
+        else
+          ops->read(block->aux, bio->sector + i, p);
+      }
+    block_complete(bio);
+  }
+}
+
+/* Called by drivers when BIO has finished, usually from an
+   interrupt handler.  Hands the device's next queued request to
+   the driver, then signals the completion of BIO, or of each of
+   the requests merged into it. */
+void block_complete(struct bio* bio) {
+  struct block* block = bio->block;
+  int64_t now = timer_ticks();
+  uint64_t now_cycles = timer_cycles();
+  struct list done;
+  struct list_elem* e;
+  enum intr_level old_level = intr_disable();
+
+  list_init(&done);
+  if (bio == &block->merged) {
+    /* Split the merged request into its parts, copying out
+       their data before the buffer is reused. */
+    uint8_t* p = block->merge_buf;
+    while (!list_empty(&block->merged_bios)) {
+      struct bio* b = list_entry(list_pop_front(&block->merged_bios), struct bio, elem);
+      if (!b->write)
+        memcpy(b->buffer, p, b->cnt * BLOCK_SECTOR_SIZE);
+      p += b->cnt * BLOCK_SECTOR_SIZE;
+      list_push_back(&done, &b->elem);
+    }
+  } else
+    list_push_back(&done, &bio->elem);
+
+  for (e = list_begin(&done); e != list_end(&done); e = list_next(e)) {
+    struct bio* b = list_entry(e, struct bio, elem);
+    if (now - b->submit_time > block->max_latency)
+      block->max_latency = now - b->submit_time;
+    record_completion(block, b, now_cycles);
+  }
+
+  if (block->active == bio) {
+    block->active = NULL;
+    start_next(block);
+  }
+  intr_set_level(old_level);
+
+  /* DONE may hand its bio to code that frees it, so calling it
+     must be the last access to the bio. */
+  while (!list_empty(&done)) {
+    struct bio* b = list_entry(list_pop_front(&done), struct bio, elem);
+    bio_done_func* done_func = b->done;
+    sema_up(&b->complete);
+    if (done_func != NULL)
+      done_func(b);
+  }
+}
+
+/* If BLOCK's driver is idle, gives it the next request chosen by
+   the I/O scheduler. */
+static void start_next(struct block* block) {
+  struct bio* bio;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (block->active != NULL)
+    return;
+  bio = iosched_next(&block->queue);
+  if (bio != NULL) {
+    block->active = merge(block, bio);
+    block->ops->start(block->aux, block->active);
+  }
+}
+
+/* Merges BIO, just taken from BLOCK's queue, with the queued
+   requests that continue it on disk, if there are any.  Returns
+   the request to give to the driver: BLOCK's merged request, or
+   BIO itself if nothing could be merged with it. */
+static struct bio* merge(struct block* block, struct bio* bio) {
+  struct bio* m = &block->merged;
+  struct bio* next;
+
+  if (block->merge_buf == NULL || bio->cnt >= MERGE_SECTORS)
+    return bio;
+  next = iosched_take_adjacent(&block->queue, bio, MERGE_SECTORS - bio->cnt);
+  if (next == NULL)
+    return bio;
+
+  bio_init(m, bio->sector, bio->cnt, block->merge_buf, bio->write);
+  m->block = block;
+  list_init(&block->merged_bios);
+  merge_add(block, bio);
+  do {
+    merge_add(block, next);
+    m->cnt += next->cnt;
+    block->merge_cnt++;
+  } while ((next = iosched_take_adjacent(&block->queue, m, MERGE_SECTORS - m->cnt)) != NULL);
+  return m;
+}
+
+/* Appends BIO to BLOCK's merged request, whose sector count does
+   not include BIO yet. */
+static void merge_add(struct block* block, struct bio* bio) {
+  size_t ofs = list_empty(&block->merged_bios) ? 0 : block->merged.cnt;
+
+  if (bio->write)
+    memcpy(block->merge_buf + ofs * BLOCK_SECTOR_SIZE, bio->buffer, bio->cnt * BLOCK_SECTOR_SIZE);
+  list_push_back(&block->merged_bios, &bio->elem);
+}
+
+/* Adds BIO, which just completed on BLOCK at time-stamp counter
+   value NOW, to BLOCK's latency histogram and to the trace. */
+static void record_completion(struct block* block, const struct bio* bio, uint64_t now) {
+  uint64_t latency = now - bio->submit_cycles;
+  struct blktrace_entry* t;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  block->latency_hist[log2_bucket(latency)]++;
+  if (!trace_enabled)
+    return;
+
+  t = &trace[trace_head];
+  strlcpy(t->device, block->name, sizeof t->device);
+  t->sector = bio->sector;
+  t->cnt = bio->cnt;
+  t->write = bio->write;
+  t->latency = latency;
+  trace_head = (trace_head + 1) % BLOCK_TRACE_CNT;
+  if (trace_used < BLOCK_TRACE_CNT)
+    trace_used++;
+  else
+    trace_lost++;
+}
+
+/* Returns the base-2 logarithm of X, rounded down, or 0 if X is
+   0. */
+static int log2_bucket(uint64_t x) {
+  uint32_t hi = x >> 32;
+  uint32_t lo = x;
+
+  if (hi != 0)
+    return 63 - __builtin_clz(hi);
+  return lo != 0 ? 31 - __builtin_clz(lo) : 0;
+}
+
+/* Starts recording completed requests in the trace. */
+void block_trace_enable(void) { trace_enabled = true; }
+
+/* Removes up to MAX of the oldest entries from the trace, copying
+   them into BUF, and returns the number copied.  BUF may be in
+   user memory, since it is not touched with interrupts off. */
+size_t block_trace_read(struct blktrace_entry* buf, size_t max) {
+  size_t copied = 0;
+
+  while (copied < max) {
+    struct blktrace_entry batch[8];
+    size_t cnt = 0;
+    enum intr_level old_level = intr_disable();
+
+    while (cnt < sizeof batch / sizeof *batch && copied + cnt < max && trace_used > 0) {
+      batch[cnt++] = trace[(trace_head + BLOCK_TRACE_CNT - trace_used) % BLOCK_TRACE_CNT];
+      trace_used--;
+    }
+    intr_set_level(old_level);
+
+    if (cnt == 0)
+      break;
+    memcpy(buf + copied, batch, cnt * sizeof *batch);
+    copied += cnt;
+  }
+  return copied;
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -121,8 +435,11 @@ const char* block_name(struct block* block) { return block->name; }
 /* Returns BLOCK's type. */
 enum block_type block_type(struct block* block) { return block->type; }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Prints statistics for each block device used for a Pintos
+   role, and I/O scheduler statistics for each device that has
+   queued requests. */
 void block_print_stats(void) {
+  struct list_elem* e;
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++) {
@@ -132,6 +449,34 @@ void block_print_stats(void) {
              block->read_cnt, block->write_cnt);
     }
   }
+
+  for (e = list_begin(&all_blocks); e != list_end(&all_blocks); e = list_next(e)) {
+    struct block* block = list_entry(e, struct block, list_elem);
+    if (block->queued_cnt > 0) {
+      unsigned long long depth = block->depth_sum * 100 / block->queued_cnt;
+      printf("%s (%s scheduler): %llu merges, average queue depth %llu.%02llu, "
+             "max latency %lld ms\n",
+             block->name, iosched_name(), block->merge_cnt, depth / 100, depth % 100,
+             block->max_latency * 1000 / TIMER_FREQ);
+    }
+  }
+
+  for (e = list_begin(&all_blocks); e != list_end(&all_blocks); e = list_next(e)) {
+    struct block* block = list_entry(e, struct block, list_elem);
+    bool printed = false;
+
+    for (i = 0; i < LATENCY_BUCKETS; i++)
+      if (block->latency_hist[i] > 0) {
+        if (!printed)
+          printf("%s latency (cycles):", block->name);
+        printf(" 2^%d: %llu", i, block->latency_hist[i]);
+        printed = true;
+      }
+    if (printed)
+      printf("\n");
+  }
+  if (trace_lost > 0)
+    printf("Block trace: %llu entries lost\n", trace_lost);
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -153,6 +498,15 @@ struct block* block_register(const char* name, enum block_type type, const char*
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  iosched_init(&block->queue);
+  block->active = NULL;
+  list_init(&block->merged_bios);
+  block->merge_buf = ops->start != NULL ? malloc(MERGE_SECTORS * BLOCK_SECTOR_SIZE) : NULL;
+  block->queued_cnt = 0;
+  block->depth_sum = 0;
+  block->merge_cnt = 0;
+  block->max_latency = 0;
+  memset(block->latency_hist, 0, sizeof block->latency_hist);
 
   printf("%s: %'" PRDSNu " sectors (", block->name, block->size);
   print_human_readable_size((uint64_t)block->size * BLOCK_SECTOR_SIZE);
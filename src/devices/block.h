@@ -55,19 +55,50 @@ struct block* block_next(struct block*);
 block_sector_t block_size(struct block*);
 void block_read(struct block*, block_sector_t, void*);
 void block_write(struct block*, block_sector_t, const void*);
+void block_read_multiple(struct block*, block_sector_t, size_t cnt, void*);
+void block_write_multiple(struct block*, block_sector_t, size_t cnt, const void*);
 const char* block_name(struct block*);
 enum block_type block_type(struct block*);
 
+/* Asynchronous I/O.  See devices/bio.h. */
+struct bio;
+void block_submit(struct block*, struct bio*);
+
 /* Statistics. */
 void block_print_stats(void);
 
+/* Tracing.  The trace holds at most BLOCK_TRACE_CNT entries. */
+#define BLOCK_TRACE_CNT 256
+struct blktrace_entry;
+void block_trace_enable(void);
+size_t block_trace_read(struct blktrace_entry*, size_t max);
+
 /* Lower-level interface to block device drivers. */
 
 struct block_operations {
   void (*read)(void* aux, block_sector_t, void* buffer);
   void (*write)(void* aux, block_sector_t, const void* buffer);
+
+  /* Optional: transfer CNT consecutive sectors at once.  If
+     null, the block layer calls read or write once per sector. */
+  void (*read_multiple)(void* aux, block_sector_t, size_t cnt, void* buffer);
+  void (*write_multiple)(void* aux, block_sector_t, size_t cnt, const void* buffer);
+
+  /* Optional, for asynchronous drivers: starts the given request
+     and returns without waiting for it.  Called with interrupts
+     off, at most one request at a time per device; the driver
+     calls block_complete() when the request finishes.  A device
+     with START needs no other operations. */
+  void (*start)(void* aux, struct bio*);
+
+  /* Optional, for devices layered on others: takes over a
+     submitted request entirely, e.g. by resubmitting it to
+     another device. */
+  void (*submit)(void* aux, struct bio*);
 };
 
+void block_complete(struct bio*);
+
 struct block* block_register(const char* name, enum block_type, const char* extra_info,
                              block_sector_t size, const struct block_operations*, void* aux);
 
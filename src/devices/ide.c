@@ -3,15 +3,22 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include "devices/bio.h"
 #include "devices/block.h"
 #include "devices/partition.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  If the
+   controller is a PCI bus-master IDE controller, such as the
+   PIIX emulated by QEMU and Bochs, data moves by DMA; otherwise
+   it moves by PIO. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)   /* Data. */
@@ -34,6 +41,7 @@
 #define STA_BSY 0x80  /* Busy. */
 #define STA_DRDY 0x40 /* Device Ready. */
 #define STA_DRQ 0x08  /* Data Request. */
+#define STA_ERR 0x01  /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04 /* Software Reset. */
@@ -49,6 +57,51 @@
 #define CMD_IDENTIFY_DEVICE 0xec    /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20  /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30 /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4      /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5     /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6  /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8           /* READ DMA. */
+#define CMD_WRITE_DMA 0xca          /* WRITE DMA. */
+
+/* PCI configuration space access. */
+#define PCI_CONFIG_ADDRESS 0xcf8 /* Selects a register. */
+#define PCI_CONFIG_DATA 0xcfc    /* Reads or writes it. */
+#define PCI_COMMAND 0x04         /* Command register. */
+#define PCI_CLASS 0x08           /* Class, subclass, prog-if, revision. */
+#define PCI_BAR4 0x20            /* Base address 4: bus-master registers. */
+#define PCI_CMD_IO 0x01          /* Enable I/O space. */
+#define PCI_CMD_MASTER 0x04      /* Enable bus mastering. */
+
+/* Bus-master IDE register addresses, relative to each channel's
+   bm_base. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table address. */
+
+/* Bus-master Command Register bits. */
+#define BM_CMD_START 0x01 /* Start transfer. */
+#define BM_CMD_READ 0x08  /* Transfer from disk to memory. */
+
+/* Bus-master Status Register bits. */
+#define BM_STA_ERR 0x02  /* Transfer failed.  Write 1 to clear. */
+#define BM_STA_INTR 0x04 /* Disk interrupted.  Write 1 to clear. */
+
+/* Physical region descriptor: one physically contiguous piece of
+   a DMA transfer.  A region may not cross a 64 kB boundary. */
+struct prd {
+  uint32_t addr;  /* Physical address. */
+  uint16_t size;  /* Size in bytes, 0 meaning 64 kB. */
+  uint16_t flags; /* PRD_EOT in the last entry. */
+};
+#define PRD_EOT 0x8000 /* End of table. */
+
+/* PRD table entries per channel: enough for MAX_COMMAND_SECTORS
+   sectors, which span at most three 64 kB regions. */
+#define PRD_CNT 4
+
+/* Most sectors a single read or write command can transfer.  A
+   sector count of 0 in the Sector Count register means 256. */
+#define MAX_COMMAND_SECTORS 256
 
 /* An ATA device. */
 struct ata_disk {
@@ -56,6 +109,16 @@ struct ata_disk {
   struct channel* channel; /* Channel that disk is attached to. */
   int dev_no;              /* Device 0 or 1 for master or slave. */
   bool is_ata;             /* Is device an ATA disk? */
+  bool dma;                /* Transfer data by bus-master DMA? */
+  size_t multiple;         /* Sectors per interrupt for READ/WRITE MULTIPLE,
+                              0 if the disk doesn't support them. */
+};
+
+/* Progress of a channel's current command. */
+enum command_state {
+  CMD_SELECT,  /* Waiting for the channel to be idle to select the disk. */
+  CMD_DRQ,     /* PIO write issued, waiting for the disk to ask for data. */
+  CMD_RUNNING, /* Waiting for the disk to interrupt. */
 };
 
 /* An ATA channel (aka controller).
@@ -65,10 +128,24 @@ struct channel {
   uint16_t reg_base; /* Base I/O port. */
   uint8_t irq;       /* Interrupt in use. */
 
-  struct lock lock;                 /* Must acquire to access the controller. */
   bool expecting_interrupt;         /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
-  struct semaphore completion_wait; /* Up'd by interrupt handler. */
+  struct semaphore completion_wait; /* Up'd by interrupt handler while probing. */
+
+  /* Request processing.  Only touched with interrupts off. */
+  struct bio* active;  /* Request in progress, or null. */
+  struct list pending; /* Requests waiting for the channel. */
+  size_t bio_done;     /* Sectors of ACTIVE finished by earlier commands. */
+  size_t cmd_cnt;      /* Sectors in the current command. */
+  size_t cmd_done;     /* Sectors of the current command finished. */
+  size_t cmd_block;    /* Sectors in the PIO write block in flight. */
+  bool cmd_dma;        /* Whether the current command uses DMA. */
+  enum command_state cmd_state; /* Progress of the current command. */
+  struct semaphore poll_wait;   /* Up'd to have poll_thread() finish a command. */
+
+  uint16_t bm_base;             /* Bus-master registers, 0 if none. */
+  struct prd prd_table[PRD_CNT] /* DMA scatter list. */
+      __attribute__((aligned(sizeof(struct prd) * PRD_CNT)));
 
   struct ata_disk devices[2]; /* The devices on this channel. */
 };
@@ -82,21 +159,41 @@ static struct block_operations ide_operations;
 static void reset_channel(struct channel*);
 static bool check_device_type(struct ata_disk*);
 static void identify_ata_device(struct ata_disk*);
-
-static void select_sector(struct ata_disk*, block_sector_t);
+static void set_multiple_mode(struct ata_disk*, size_t max);
+
+static uint16_t find_bus_master(void);
+static uint32_t pci_read_config(int bus, int dev, int func, int reg);
+static void pci_write_config(int bus, int dev, int func, int reg, uint32_t value);
+static bool dma_usable(const struct ata_disk*, const void* buffer);
+static void dma_start(struct ata_disk*, block_sector_t, size_t cnt, void*, bool read);
+static bool dma_finish(struct channel*);
+
+static void start_request(struct channel*, struct bio*);
+static void start_command(struct channel*);
+static bool continue_command(struct channel*);
+static void poll_thread(void* c_);
+static size_t pio_block(struct channel*, uint8_t**);
+static void output_block(struct channel*);
+static void service_request(struct channel*, uint8_t status);
+
+static void select_sector(struct ata_disk*, block_sector_t, size_t cnt);
 static void issue_pio_command(struct channel*, uint8_t command);
-static void input_sector(struct channel*, void*);
-static void output_sector(struct channel*, const void*);
+static void issue_command(struct channel*, uint8_t command);
+static void input_sectors(struct channel*, void*, size_t cnt);
+static void output_sectors(struct channel*, const void*, size_t cnt);
 
 static void wait_until_idle(const struct ata_disk*);
 static bool wait_while_busy(const struct ata_disk*);
+static bool channel_idle(const struct channel*);
 static void select_device(const struct ata_disk*);
 static void select_device_wait(const struct ata_disk*);
+static bool select_device_ready(const struct ata_disk*);
 
 static void interrupt_handler(struct intr_frame*);
 
 /* Initialize the disk subsystem and detect disks. */
 void ide_init(void) {
+  uint16_t bm_base = find_bus_master();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) {
@@ -117,9 +214,12 @@ void ide_init(void) {
       default:
         NOT_REACHED();
     }
-    lock_init(&c->lock);
     c->expecting_interrupt = false;
     sema_init(&c->completion_wait, 0);
+    c->active = NULL;
+    list_init(&c->pending);
+    sema_init(&c->poll_wait, 0);
+    c->bm_base = bm_base != 0 ? bm_base + chan_no * 8 : 0;
 
     /* Initialize devices. */
     for (dev_no = 0; dev_no < 2; dev_no++) {
@@ -128,6 +228,8 @@ void ide_init(void) {
       d->channel = c;
       d->dev_no = dev_no;
       d->is_ata = false;
+      d->dma = false;
+      d->multiple = 0;
     }
 
     /* Register interrupt handler. */
@@ -144,6 +246,8 @@ void ide_init(void) {
     for (dev_no = 0; dev_no < 2; dev_no++)
       if (c->devices[dev_no].is_ata)
         identify_ata_device(&c->devices[dev_no]);
+
+    thread_create(c->name, PRI_DEFAULT, poll_thread, c);
   }
 }
 
@@ -255,7 +359,7 @@ static void identify_ata_device(struct ata_disk* d) {
     d->is_ata = false;
     return;
   }
-  input_sector(c, id);
+  input_sectors(c, id, 1);
 
   /* Calculate capacity.
      Read model name and serial number. */
@@ -277,6 +381,15 @@ static void identify_ata_device(struct ata_disk* d) {
     return;
   }
 
+  /* Word 47 holds the most sectors the disk can transfer per
+     interrupt with READ/WRITE MULTIPLE. */
+  set_multiple_mode(d, *(uint16_t*)&id[47 * 2] & 0xff);
+
+  /* Bit 8 of word 49 says whether the disk supports DMA. */
+  d->dma = c->bm_base != 0 && (*(uint16_t*)&id[49 * 2] & 0x100) != 0;
+  if (d->dma)
+    strlcat(extra_info, ", DMA", sizeof extra_info);
+
   /* Register. */
   block = block_register(d->name, BLOCK_RAW, extra_info, capacity, &ide_operations, d);
   partition_scan(block);
@@ -306,53 +419,235 @@ static char* descramble_ata_string(char* string, int size) {
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void ide_read(void* d_, block_sector_t sec_no, void* buffer) {
-  struct ata_disk* d = d_;
+/* Enables READ MULTIPLE and WRITE MULTIPLE on disk D, moving up
+   to MAX sectors per interrupt.  Leaves them disabled if MAX is
+   0 or the disk rejects the setting. */
+static void set_multiple_mode(struct ata_disk* d, size_t max) {
   struct channel* c = d->channel;
-  lock_acquire(&c->lock);
-  select_sector(d, sec_no);
-  issue_pio_command(c, CMD_READ_SECTOR_RETRY);
+
+  d->multiple = 0;
+  if (max == 0)
+    return;
+
+  select_device_wait(d);
+  outb(reg_nsect(c), max);
+  issue_pio_command(c, CMD_SET_MULTIPLE_MODE);
   sema_down(&c->completion_wait);
-  if (!wait_while_busy(d))
-    PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sec_no);
-  input_sector(c, buffer);
-  lock_release(&c->lock);
-}
-
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void ide_write(void* d_, block_sector_t sec_no, const void* buffer) {
+  wait_while_busy(d);
+  if ((inb(reg_status(c)) & STA_ERR) == 0)
+    d->multiple = max;
+}
+
+/* Request processing.
+
+   Requests reach the driver through ide_start(), which the block
+   layer calls with interrupts off whenever a disk's queue has a
+   request ready.  Each channel works on one request at a time;
+   requests for the channel's other disk wait in its pending
+   list.  A request is carried out as one or more commands of up
+   to MAX_COMMAND_SECTORS sectors each.  The interrupt handler
+   moves each block of PIO data or finishes each DMA transfer,
+   issues the request's next command, and when the request is
+   done, starts the next one before telling the block layer, so
+   the disk never waits for a thread to be scheduled.
+
+   Neither the interrupt handler nor ide_start() ever waits for
+   the disk, which would hold up every CPU that wants to turn
+   interrupts off.  A disk that has just interrupted is normally
+   idle, and QEMU and Bochs ask for PIO write data as soon as the
+   command is written, so a command can usually be issued at
+   once.  When the disk is not ready yet, the step is left to the
+   channel's poll_thread(), which polls with interrupts on. */
+
+/* Hands BIO, a request for disk D, to D's channel.  Starts it
+   at once if the channel is idle, otherwise queues it behind the
+   channel's current request.  Called with interrupts off. */
+static void ide_start(void* d_, struct bio* bio) {
   struct ata_disk* d = d_;
   struct channel* c = d->channel;
-  lock_acquire(&c->lock);
-  select_sector(d, sec_no);
-  issue_pio_command(c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy(d))
-    PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sec_no);
-  output_sector(c, buffer);
-  sema_down(&c->completion_wait);
-  lock_release(&c->lock);
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  bio->driver_aux = d;
+  if (c->active != NULL)
+    list_push_back(&c->pending, &bio->elem);
+  else
+    start_request(c, bio);
 }
 
-static struct block_operations ide_operations = {ide_read, ide_write};
+static struct block_operations ide_operations = {.start = ide_start};
 
-/* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
-static void select_sector(struct ata_disk* d, block_sector_t sec_no) {
+/* Makes BIO channel C's active request and issues its first
+   command. */
+static void start_request(struct channel* c, struct bio* bio) {
+  c->active = bio;
+  c->bio_done = 0;
+  start_command(c);
+}
+
+/* Starts the next command for channel C's active request,
+   covering as many of its remaining sectors as one command can.
+   If the disk is not ready for it, leaves the command to
+   poll_thread(). */
+static void start_command(struct channel* c) {
+  struct bio* bio = c->active;
+  size_t left = bio->cnt - c->bio_done;
+
+  c->cmd_cnt = left < MAX_COMMAND_SECTORS ? left : MAX_COMMAND_SECTORS;
+  c->cmd_done = 0;
+  c->cmd_dma = dma_usable(bio->driver_aux,
+                          (uint8_t*)bio->buffer + c->bio_done * BLOCK_SECTOR_SIZE);
+  c->cmd_state = CMD_SELECT;
+  if (!continue_command(c))
+    sema_up(&c->poll_wait);
+}
+
+/* Carries channel C's current command as far as the disk allows
+   without waiting: selects the disk and issues the command, and
+   for a PIO write, sends the first block of data.  Returns true
+   if the command is now running, false if the disk was not ready
+   and this must be called again.  Interrupts must be off. */
+static bool continue_command(struct channel* c) {
+  struct bio* bio = c->active;
+  struct ata_disk* d = bio->driver_aux;
+  block_sector_t sector = bio->sector + c->bio_done;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (c->cmd_state == CMD_SELECT) {
+    if (!select_device_ready(d))
+      return false;
+    if (c->cmd_dma) {
+      dma_start(d, sector, c->cmd_cnt, (uint8_t*)bio->buffer + c->bio_done * BLOCK_SECTOR_SIZE,
+                !bio->write);
+      c->cmd_state = CMD_RUNNING;
+      return true;
+    }
+
+    select_sector(d, sector, c->cmd_cnt);
+    if (!bio->write) {
+      issue_command(c, d->multiple > 0 ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+      c->cmd_state = CMD_RUNNING;
+      return true;
+    }
+    issue_command(c, d->multiple > 0 ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+    c->cmd_state = CMD_DRQ;
+  }
+
+  if (c->cmd_state == CMD_DRQ) {
+    uint8_t status = inb(reg_alt_status(c));
+    if (status & STA_BSY)
+      return false;
+    if ((status & STA_ERR) || !(status & STA_DRQ))
+      PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sector);
+    c->cmd_state = CMD_RUNNING;
+    output_block(c);
+  }
+  return true;
+}
+
+/* Finishes starting the commands on channel C, passed as C_,
+   that the disk was not ready for: polls the disk, with
+   interrupts on, until the command can go ahead.  Panics if the
+   disk is still not ready after 10 seconds. */
+static void poll_thread(void* c_) {
+  struct channel* c = c_;
+
+  for (;;) {
+    int64_t start;
+
+    sema_down(&c->poll_wait);
+    start = timer_ticks();
+    for (;;) {
+      enum intr_level old_level;
+      bool running;
+
+      timer_usleep(10);
+      old_level = intr_disable();
+      running = continue_command(c);
+      intr_set_level(old_level);
+      if (running)
+        break;
+      if (timer_elapsed(start) > 10 * TIMER_FREQ)
+        PANIC("%s: disk not ready", c->name);
+    }
+  }
+}
+
+/* Returns the number of sectors channel C moves per interrupt
+   in its current PIO command, and the data's position. */
+static size_t pio_block(struct channel* c, uint8_t** p) {
+  struct ata_disk* d = c->active->driver_aux;
+  size_t per_intr = d->multiple > 0 ? d->multiple : 1;
+  size_t left = c->cmd_cnt - c->cmd_done;
+
+  *p = (uint8_t*)c->active->buffer + (c->bio_done + c->cmd_done) * BLOCK_SECTOR_SIZE;
+  return left < per_intr ? left : per_intr;
+}
+
+/* Sends channel C's next block of PIO write data.  The disk
+   interrupts once it has taken the block. */
+static void output_block(struct channel* c) {
+  uint8_t* p;
+  c->cmd_block = pio_block(c, &p);
+  output_sectors(c, p, c->cmd_block);
+}
+
+/* Handles a completion interrupt for channel C's active
+   request, which left status STATUS in the status register. */
+static void service_request(struct channel* c, uint8_t status) {
+  struct bio* bio = c->active;
+  struct ata_disk* d = bio->driver_aux;
+  block_sector_t sector = bio->sector + c->bio_done + c->cmd_done;
+
+  if (c->cmd_dma) {
+    if (!dma_finish(c) || (status & STA_ERR))
+      PANIC("%s: DMA %s failed, sector=%" PRDSNu, d->name, bio->write ? "write" : "read",
+            sector);
+    c->cmd_done = c->cmd_cnt;
+  } else if (!bio->write) {
+    uint8_t* p;
+    size_t k = pio_block(c, &p);
+    if ((status & STA_ERR) || !(status & STA_DRQ))
+      PANIC("%s: disk read failed, sector=%" PRDSNu, d->name, sector);
+    input_sectors(c, p, k);
+    c->cmd_done += k;
+  } else {
+    if (status & STA_ERR)
+      PANIC("%s: disk write failed, sector=%" PRDSNu, d->name, sector);
+    c->cmd_done += c->cmd_block;
+    if (c->cmd_done < c->cmd_cnt) {
+      output_block(c);
+      return;
+    }
+  }
+
+  if (c->cmd_done < c->cmd_cnt)
+    return;
+  c->bio_done += c->cmd_cnt;
+  if (c->bio_done < bio->cnt) {
+    start_command(c);
+    return;
+  }
+
+  /* The request is done.  Give the channel to the next waiting
+     request first, so that both of its disks get turns. */
+  c->active = NULL;
+  if (!list_empty(&c->pending))
+    start_request(c, list_entry(list_pop_front(&c->pending), struct bio, elem));
+  block_complete(bio);
+}
+
+/* Writes SEC_NO and the sector count CNT to the sector
+   selection registers of device D, which must already be
+   selected and idle.  (We use LBA mode.) */
+static void select_sector(struct ata_disk* d, block_sector_t sec_no, size_t cnt) {
   struct channel* c = d->channel;
 
   ASSERT(sec_no < (1UL << 28));
+  ASSERT(cnt >= 1 && cnt <= MAX_COMMAND_SECTORS);
 
-  select_device_wait(d);
-  outb(reg_nsect(c), 1);
+  outb(reg_nsect(c), cnt); /* 256 wraps to 0, which means 256. */
   outb(reg_lbal(c), sec_no);
   outb(reg_lbam(c), sec_no >> 8);
   outb(reg_lbah(c), (sec_no >> 16));
@@ -360,26 +655,138 @@ static void select_sector(struct ata_disk* d, block_sector_t sec_no) {
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
-   completion interrupt. */
+   completion interrupt, which will up completion_wait. */
 static void issue_pio_command(struct channel* c, uint8_t command) {
   /* Interrupts must be enabled or our semaphore will never be
      up'd by the completion handler. */
   ASSERT(intr_get_level() == INTR_ON);
 
+  issue_command(c, command);
+}
+
+/* Writes COMMAND to channel C and prepares for receiving a
+   completion interrupt.  May be called from interrupt context. */
+static void issue_command(struct channel* c, uint8_t command) {
   c->expecting_interrupt = true;
   outb(reg_command(c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
-static void input_sector(struct channel* c, void* sector) {
-  insw(reg_data(c), sector, BLOCK_SECTOR_SIZE / 2);
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
+static void input_sectors(struct channel* c, void* sectors, size_t cnt) {
+  insw(reg_data(c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
+}
+
+/* Writes CNT sectors from SECTORS to channel C's data register in
+   PIO mode.  SECTORS must contain CNT * BLOCK_SECTOR_SIZE bytes. */
+static void output_sectors(struct channel* c, const void* sectors, size_t cnt) {
+  outsw(reg_data(c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
+}
+
+/* Bus-master DMA. */
+
+/* Looks for a PCI IDE controller capable of bus-master DMA on
+   bus 0 and enables bus mastering on it.  Returns the I/O port
+   base of its bus-master registers, or 0 if there is none. */
+static uint16_t find_bus_master(void) {
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++) {
+      uint32_t class, bar4;
+
+      if ((pci_read_config(0, dev, func, 0) & 0xffff) == 0xffff)
+        continue;
+
+      /* Mass storage (1), IDE (1), bus-master capable (prog-if bit 7). */
+      class = pci_read_config(0, dev, func, PCI_CLASS);
+      if ((class >> 24) != 0x01 || ((class >> 16) & 0xff) != 0x01 || !(class & 0x8000))
+        continue;
+
+      /* BAR4 must be in I/O space. */
+      bar4 = pci_read_config(0, dev, func, PCI_BAR4);
+      if (!(bar4 & 1) || (bar4 & 0xfffc) == 0)
+        continue;
+
+      pci_write_config(0, dev, func, PCI_COMMAND,
+                       pci_read_config(0, dev, func, PCI_COMMAND) | PCI_CMD_IO | PCI_CMD_MASTER);
+      return bar4 & 0xfffc;
+    }
+  return 0;
+}
+
+/* Returns the 32-bit register at offset REG in the configuration
+   space of PCI function FUNC of device DEV on BUS. */
+static uint32_t pci_read_config(int bus, int dev, int func, int reg) {
+  outl(PCI_CONFIG_ADDRESS, 0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xfc));
+  return inl(PCI_CONFIG_DATA);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain BLOCK_SECTOR_SIZE bytes. */
-static void output_sector(struct channel* c, const void* sector) {
-  outsw(reg_data(c), sector, BLOCK_SECTOR_SIZE / 2);
+/* Writes VALUE to the 32-bit register at offset REG in the
+   configuration space of PCI function FUNC of device DEV on
+   BUS. */
+static void pci_write_config(int bus, int dev, int func, int reg, uint32_t value) {
+  outl(PCI_CONFIG_ADDRESS, 0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (reg & 0xfc));
+  outl(PCI_CONFIG_DATA, value);
+}
+
+/* Returns true if a transfer between disk D and BUFFER can use
+   DMA.  The controller needs the physical address of BUFFER,
+   which must therefore be in the kernel's linear mapping of
+   physical memory, and word-aligned. */
+static bool dma_usable(const struct ata_disk* d, const void* buffer) {
+  return d->dma && is_kernel_vaddr(buffer) && ((uintptr_t)buffer & 1) == 0;
+}
+
+/* Starts moving CNT sectors starting at SEC_NO between disk D,
+   which must already be selected and idle, and BUFFER by
+   bus-master DMA, from the disk to BUFFER if READ is true and
+   the other way otherwise.  The controller interrupts when the
+   transfer is over; then call dma_finish(). */
+static void dma_start(struct ata_disk* d, block_sector_t sec_no, size_t cnt, void* buffer,
+                      bool read) {
+  struct channel* c = d->channel;
+  uintptr_t addr = vtop(buffer);
+  size_t size = cnt * BLOCK_SECTOR_SIZE;
+  struct prd* prd = c->prd_table;
+
+  ASSERT(cnt >= 1 && cnt <= MAX_COMMAND_SECTORS);
+
+  /* Describe BUFFER, which is physically contiguous, in pieces
+     that do not cross 64 kB boundaries. */
+  while (size > 0) {
+    size_t chunk = 0x10000 - (addr & 0xffff);
+    if (chunk > size)
+      chunk = size;
+    ASSERT(prd < c->prd_table + PRD_CNT);
+    prd->addr = addr;
+    prd->size = chunk & 0xffff;
+    prd->flags = 0;
+    addr += chunk;
+    size -= chunk;
+    prd++;
+  }
+  prd[-1].flags = PRD_EOT;
+
+  outl(reg_bm_prdt(c), vtop(c->prd_table));
+  outb(reg_bm_command(c), read ? BM_CMD_READ : 0);
+  outb(reg_bm_status(c), BM_STA_ERR | BM_STA_INTR);
+
+  select_sector(d, sec_no, cnt);
+  issue_command(c, read ? CMD_READ_DMA : CMD_WRITE_DMA);
+  outb(reg_bm_command(c), (read ? BM_CMD_READ : 0) | BM_CMD_START);
+}
+
+/* Stops channel C's bus-master engine after a DMA transfer and
+   returns true if the transfer succeeded. */
+static bool dma_finish(struct channel* c) {
+  uint8_t bm_status;
+
+  outb(reg_bm_command(c), 0);
+  bm_status = inb(reg_bm_status(c));
+  outb(reg_bm_status(c), BM_STA_ERR | BM_STA_INTR);
+  return (bm_status & BM_STA_ERR) == 0;
 }
 
 /* Low-level ATA primitives. */
@@ -395,7 +802,7 @@ static void wait_until_idle(const struct ata_disk* d) {
   for (i = 0; i < 1000; i++) {
     if ((inb(reg_status(d->channel)) & (STA_BSY | STA_DRQ)) == 0)
       return;
-    timer_usleep(10);
+    timer_udelay(10);
   }
 
   printf("%s: idle timeout\n", d->name);
@@ -424,6 +831,13 @@ static bool wait_while_busy(const struct ata_disk* d) {
   return false;
 }
 
+/* Returns true if channel C is idle, that is, if the BSY and DRQ
+   bits are clear in its status register.  Like wait_until_idle(),
+   clears any pending interrupt. */
+static bool channel_idle(const struct channel* c) {
+  return (inb(reg_status(c)) & (STA_BSY | STA_DRQ)) == 0;
+}
+
 /* Program D's channel so that D is now the selected disk. */
 static void select_device(const struct ata_disk* d) {
   struct channel* c = d->channel;
@@ -432,7 +846,7 @@ static void select_device(const struct ata_disk* d) {
     dev |= DEV_DEV;
   outb(reg_device(c), dev);
   inb(reg_alt_status(c));
-  timer_nsleep(400);
+  timer_ndelay(400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -443,6 +857,17 @@ static void select_device_wait(const struct ata_disk* d) {
   wait_until_idle(d);
 }
 
+/* Selects disk D in its channel, as select_device_wait(), but
+   without waiting for the channel: returns false at once if it
+   is busy before or after.  May be called from interrupt
+   context. */
+static bool select_device_ready(const struct ata_disk* d) {
+  if (!channel_idle(d->channel))
+    return false;
+  select_device(d);
+  return channel_idle(d->channel);
+}
+
 /* ATA interrupt handler. */
 static void interrupt_handler(struct intr_frame* f) {
   struct channel* c;
@@ -450,8 +875,14 @@ static void interrupt_handler(struct intr_frame* f) {
   for (c = channels; c < channels + CHANNEL_CNT; c++)
     if (f->vec_no == c->irq) {
       if (c->expecting_interrupt) {
-        inb(reg_status(c));           /* Acknowledge interrupt. */
-        sema_up(&c->completion_wait); /* Wake up waiter. */
+        uint8_t status = inb(reg_status(c)); /* Acknowledge interrupt. */
+        if (c->active != NULL) {
+          /* A command still being started by poll_thread() has
+             nothing to service yet. */
+          if (c->cmd_state == CMD_RUNNING)
+            service_request(c, status);
+        } else
+          sema_up(&c->completion_wait); /* Wake up waiter. */
       } else
         printf("%s: unexpected interrupt\n", c->name);
       return;
@@ -0,0 +1,161 @@
+#include "devices/iosched.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/bio.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+
+/* How long a request may wait before the deadline policy serves
+   it out of sector order, in timer ticks.  Reads get the shorter
+   deadline because some thread is usually blocked on each one,
+   while most writes come from the buffer cache writing back. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (5 * TIMER_FREQ)
+
+/* An I/O scheduling policy. */
+struct iosched {
+  const char* name;                           /* Name for -iosched. */
+  bool sorted;                                /* Keep requests in sector order? */
+  struct bio* (*next)(struct iosched_queue*); /* Picks the next request. */
+};
+
+static struct bio* noop_next(struct iosched_queue*);
+static struct bio* clook_next(struct iosched_queue*);
+static struct bio* deadline_next(struct iosched_queue*);
+
+static const struct iosched policies[] = {
+    {"noop", false, noop_next},
+    {"clook", true, clook_next},
+    {"deadline", true, deadline_next},
+};
+
+/* Policy in use. */
+static const struct iosched* policy = &policies[2];
+
+static bool sector_less(const struct list_elem*, const struct list_elem*, void* aux);
+static void take(struct iosched_queue*, struct bio*);
+
+/* Makes the policy called NAME the one used for every block
+   device.  Must be called before any requests are submitted.
+   Returns false if there is no such policy. */
+bool iosched_select(const char* name) {
+  size_t i;
+
+  for (i = 0; i < sizeof policies / sizeof *policies; i++)
+    if (!strcmp(name, policies[i].name)) {
+      policy = &policies[i];
+      return true;
+    }
+  return false;
+}
+
+/* Returns the name of the policy in use. */
+const char* iosched_name(void) { return policy->name; }
+
+/* Initializes Q as an empty queue. */
+void iosched_init(struct iosched_queue* q) {
+  list_init(&q->sorted);
+  list_init(&q->fifo[0]);
+  list_init(&q->fifo[1]);
+  q->cnt = 0;
+  q->head = 0;
+}
+
+/* Adds BIO to Q. */
+void iosched_add(struct iosched_queue* q, struct bio* bio) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (policy->sorted)
+    list_insert_ordered(&q->sorted, &bio->elem, sector_less, NULL);
+  else
+    list_push_back(&q->sorted, &bio->elem);
+  list_push_back(&q->fifo[bio->write], &bio->fifo_elem);
+  q->cnt++;
+}
+
+/* Removes and returns the request in Q that should go to the
+   device next, or a null pointer if Q is empty. */
+struct bio* iosched_next(struct iosched_queue* q) {
+  struct bio* bio;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (q->cnt == 0)
+    return NULL;
+  bio = policy->next(q);
+  take(q, bio);
+  return bio;
+}
+
+/* Removes and returns a request in Q, of no more than MAX_CNT
+   sectors, that moves data in the same direction as BIO and
+   starts at the sector just after BIO's last one, so that the
+   two can be carried out by a single command.  Returns a null
+   pointer if there is no such request. */
+struct bio* iosched_take_adjacent(struct iosched_queue* q, const struct bio* bio, size_t max_cnt) {
+  block_sector_t end = bio->sector + bio->cnt;
+  struct list_elem* e;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (e = list_begin(&q->sorted); e != list_end(&q->sorted); e = list_next(e)) {
+    struct bio* b = list_entry(e, struct bio, elem);
+    if (b->sector == end && b->write == bio->write && b->cnt <= max_cnt) {
+      take(q, b);
+      return b;
+    }
+    if (policy->sorted && b->sector > end)
+      break;
+  }
+  return NULL;
+}
+
+/* Noop policy: the oldest request. */
+static struct bio* noop_next(struct iosched_queue* q) {
+  return list_entry(list_front(&q->sorted), struct bio, elem);
+}
+
+/* C-LOOK policy: the lowest-numbered request at or after the
+   head position, or the lowest-numbered request if none. */
+static struct bio* clook_next(struct iosched_queue* q) {
+  struct list_elem* e;
+
+  for (e = list_begin(&q->sorted); e != list_end(&q->sorted); e = list_next(e)) {
+    struct bio* b = list_entry(e, struct bio, elem);
+    if (b->sector >= q->head)
+      return b;
+  }
+  return list_entry(list_front(&q->sorted), struct bio, elem);
+}
+
+/* Deadline policy: the oldest read if it has expired, otherwise
+   the oldest write if it has expired, otherwise as for C-LOOK. */
+static struct bio* deadline_next(struct iosched_queue* q) {
+  static const int64_t expire[2] = {READ_EXPIRE, WRITE_EXPIRE};
+  int64_t now = timer_ticks();
+  int write;
+
+  for (write = 0; write < 2; write++)
+    if (!list_empty(&q->fifo[write])) {
+      struct bio* b = list_entry(list_front(&q->fifo[write]), struct bio, fifo_elem);
+      if (now - b->submit_time >= expire[write])
+        return b;
+    }
+  return clook_next(q);
+}
+
+/* Removes BIO from Q and moves Q's head position past it. */
+static void take(struct iosched_queue* q, struct bio* bio) {
+  list_remove(&bio->elem);
+  list_remove(&bio->fifo_elem);
+  q->cnt--;
+  q->head = bio->sector + bio->cnt;
+}
+
+/* Orders bios by starting sector. */
+static bool sector_less(const struct list_elem* a_, const struct list_elem* b_,
+                        void* aux UNUSED) {
+  const struct bio* a = list_entry(a_, struct bio, elem);
+  const struct bio* b = list_entry(b_, struct bio, elem);
+  return a->sector < b->sector;
+}
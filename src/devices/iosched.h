@@ -0,0 +1,46 @@
+#ifndef DEVICES_IOSCHED_H
+#define DEVICES_IOSCHED_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* I/O scheduler.
+
+   Requests submitted to an asynchronous block device wait in an
+   iosched_queue until the driver is free.  The scheduling policy,
+   chosen once for all devices at boot, decides which waiting
+   request the driver gets next:
+
+     - noop: arrival order.
+
+     - clook: ascending sector order, starting from where the
+       last request left off and wrapping around to the lowest
+       sector at the end ("circular LOOK"), which keeps the disk
+       head sweeping in one direction.
+
+     - deadline: like clook, except that a read that has waited
+       READ_EXPIRE ticks or a write that has waited WRITE_EXPIRE
+       ticks goes first, so that a burst of writes cannot starve
+       readers.
+
+   Iosched_queue functions must be called with interrupts off. */
+
+/* Requests waiting for a block device. */
+struct iosched_queue {
+  struct list sorted;  /* By sector, or by arrival for noop. */
+  struct list fifo[2]; /* Reads, then writes, by arrival. */
+  size_t cnt;          /* Number of requests. */
+  block_sector_t head; /* Sector following the last one handed out. */
+};
+
+bool iosched_select(const char* name);
+const char* iosched_name(void);
+
+void iosched_init(struct iosched_queue*);
+void iosched_add(struct iosched_queue*, struct bio*);
+struct bio* iosched_next(struct iosched_queue*);
+struct bio* iosched_take_adjacent(struct iosched_queue*, const struct bio*, size_t max_cnt);
+
+#endif /* devices/iosched.h */
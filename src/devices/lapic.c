@@ -0,0 +1,177 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include "devices/timer.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Local APIC.
+
+   Every CPU has a local APIC, which among other things lets it
+   send inter-processor interrupts (IPIs) to the other CPUs.  Its
+   registers are memory-mapped, normally at physical address
+   0xfee00000, at the same address on every CPU.  The kernel maps
+   that page at the same virtual address, which lies above the
+   64 MB of RAM mapped at PHYS_BASE.
+
+   See [IA32-v3a] chapter 10 "Advanced Programmable Interrupt
+   Controller (APIC)". */
+
+/* Register offsets. */
+#define LAPIC_ID 0x020          /* Local APIC ID. */
+#define LAPIC_EOI 0x0b0         /* End of interrupt. */
+#define LAPIC_SVR 0x0f0         /* Spurious interrupt vector. */
+#define LAPIC_ICR_LOW 0x300     /* Interrupt command, low half. */
+#define LAPIC_ICR_HIGH 0x310    /* Interrupt command, high half. */
+#define LAPIC_LVT_TIMER 0x320   /* Local vector table entry for the timer. */
+#define LAPIC_TIMER_INIT 0x380  /* Timer initial count. */
+#define LAPIC_TIMER_COUNT 0x390 /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0   /* Timer divide configuration. */
+
+/* Spurious interrupt vector register bits. */
+#define SVR_ENABLE 0x100 /* APIC software enable. */
+#define SVR_VECTOR 0xff  /* Vector for spurious interrupts. */
+
+/* Interrupt command register bits. */
+#define ICR_FIXED 0x00000   /* Fixed delivery mode. */
+#define ICR_INIT 0x00500    /* INIT delivery mode. */
+#define ICR_STARTUP 0x00600 /* Start-up delivery mode. */
+#define ICR_PENDING 0x01000 /* Delivery status: send pending. */
+#define ICR_ASSERT 0x04000  /* Level assert. */
+#define ICR_LEVEL 0x08000   /* Level triggered. */
+
+/* Timer local vector table entry bits. */
+#define LVT_MASKED 0x10000   /* Interrupt masked. */
+#define LVT_PERIODIC 0x20000 /* Reload the count when it reaches 0. */
+
+/* Timer divide configuration: divide the bus clock by 16. */
+#define TIMER_DIV_16 0x3
+
+/* Page-level cache disable, for memory-mapped registers. */
+#define PTE_PCD 0x10
+
+/* Mapped local APIC registers, or NULL if not yet mapped. */
+static volatile uint32_t* lapic;
+
+/* Timer counts per timer tick, set by lapic_timer_calibrate(). */
+static uint32_t counts_per_tick;
+
+static uint32_t lapic_read(int reg);
+static void lapic_write(int reg, uint32_t value);
+static void send_ipi(uint8_t apic_id, uint32_t command);
+
+/* Maps the local APIC registers at physical address PADDR into
+   the kernel's page directory.  Must be called before any user
+   process is created, because each process's page directory is
+   a copy of the kernel's. */
+void lapic_init(uintptr_t paddr) {
+  uint32_t* pd = init_page_dir;
+  uint8_t* vaddr = (uint8_t*)paddr;
+  uint32_t* pt;
+
+  ASSERT(pg_ofs(vaddr) == 0);
+  ASSERT(is_kernel_vaddr(vaddr));
+  ASSERT(vaddr >= (uint8_t*)ptov(init_ram_pages * PGSIZE));
+
+  if (pd[pd_no(vaddr)] == 0) {
+    pt = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+    pd[pd_no(vaddr)] = pde_create(pt);
+  } else
+    pt = pde_get_pt(pd[pd_no(vaddr)]);
+  pt[pt_no(vaddr)] = paddr | PTE_P | PTE_W | PTE_PCD;
+  asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+
+  lapic = (volatile uint32_t*)vaddr;
+}
+
+/* Enables the running CPU's local APIC. */
+void lapic_enable(void) {
+  ASSERT(lapic != NULL);
+  lapic_write(LAPIC_SVR, SVR_ENABLE | SVR_VECTOR);
+}
+
+/* Returns the running CPU's local APIC ID. */
+uint8_t lapic_id(void) {
+  ASSERT(lapic != NULL);
+  return lapic_read(LAPIC_ID) >> 24;
+}
+
+/* Sends an INIT IPI to the CPU with local APIC ID APIC_ID, which
+   resets it into a wait-for-SIPI state. */
+void lapic_send_init(uint8_t apic_id) {
+  send_ipi(apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+  send_ipi(apic_id, ICR_INIT | ICR_LEVEL);
+}
+
+/* Sends a start-up IPI to the CPU with local APIC ID APIC_ID,
+   which starts it in real mode at PADDR.  PADDR must be
+   page-aligned and below 1 MB. */
+void lapic_send_startup(uint8_t apic_id, uintptr_t paddr) {
+  ASSERT(pg_ofs((void*)paddr) == 0 && paddr < 0x100000);
+  send_ipi(apic_id, ICR_STARTUP | (paddr >> PGBITS));
+}
+
+/* Sends interrupt VEC to the CPU with local APIC ID APIC_ID. */
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec) { send_ipi(apic_id, ICR_FIXED | vec); }
+
+/* Signals the end of the interrupt being handled by the running
+   CPU's local APIC. */
+void lapic_eoi(void) { lapic_write(LAPIC_EOI, 0); }
+
+/* Measures how many times the local APIC timer counts down
+   during one tick of the 8254 timer, which must be running.
+   Every CPU's local APIC timer is assumed to run at the same
+   rate, so this need be done only once, on one CPU. */
+void lapic_timer_calibrate(void) {
+  int64_t start;
+
+  ASSERT(intr_get_level() == INTR_ON);
+
+  lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+  lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+
+  /* Start counting at the beginning of a tick. */
+  start = timer_ticks();
+  while (timer_ticks() == start)
+    barrier();
+  lapic_write(LAPIC_TIMER_INIT, UINT32_MAX);
+  start = timer_ticks();
+  while (timer_ticks() == start)
+    barrier();
+  counts_per_tick = UINT32_MAX - lapic_read(LAPIC_TIMER_COUNT);
+  lapic_write(LAPIC_TIMER_INIT, 0);
+
+  ASSERT(counts_per_tick > 0);
+}
+
+/* Starts the running CPU's local APIC timer, which then raises
+   interrupt VEC TIMER_FREQ times per second. */
+void lapic_timer_start(uint8_t vec) {
+  ASSERT(counts_per_tick > 0);
+  lapic_write(LAPIC_TIMER_DIV, TIMER_DIV_16);
+  lapic_write(LAPIC_LVT_TIMER, LVT_PERIODIC | vec);
+  lapic_write(LAPIC_TIMER_INIT, counts_per_tick);
+}
+
+/* Returns the value of local APIC register REG. */
+static uint32_t lapic_read(int reg) { return lapic[reg / sizeof *lapic]; }
+
+/* Sets local APIC register REG to VALUE. */
+static void lapic_write(int reg, uint32_t value) {
+  lapic[reg / sizeof *lapic] = value;
+  lapic_read(LAPIC_ID); /* Wait for the write to finish. */
+}
+
+/* Sends an IPI with the given COMMAND to the CPU with local APIC
+   ID APIC_ID and waits for it to be delivered. */
+static void send_ipi(uint8_t apic_id, uint32_t command) {
+  ASSERT(lapic != NULL);
+  lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+  lapic_write(LAPIC_ICR_LOW, command);
+  while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING)
+    asm volatile("pause");
+}
@@ -0,0 +1,16 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdint.h>
+
+void lapic_init(uintptr_t paddr);
+void lapic_enable(void);
+uint8_t lapic_id(void);
+void lapic_send_init(uint8_t apic_id);
+void lapic_send_startup(uint8_t apic_id, uintptr_t paddr);
+void lapic_send_ipi(uint8_t apic_id, uint8_t vec);
+void lapic_eoi(void);
+void lapic_timer_calibrate(void);
+void lapic_timer_start(uint8_t vec);
+
+#endif /* devices/lapic.h */
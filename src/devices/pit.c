@@ -11,8 +11,8 @@
 #define PIT_PORT_CONTROL 0x43                        /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL)) /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
+/* Count loaded by the last pit_start_oneshot(). */
+static uint16_t oneshot_count;
 
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
@@ -75,3 +75,49 @@ void pit_configure_channel(int channel, int mode, int frequency) {
   outb(PIT_PORT_COUNTER(channel), count >> 8);
   intr_set_level(old_level);
 }
+
+/* Starts channel 0 counting down from COUNT, which must be
+   nonzero, in mode 0.  When the count reaches 0, the channel's
+   output rises, raising interrupt line 0 once; the counter then
+   wraps around to 65535 and keeps counting down, so that
+   pit_oneshot_elapsed() can tell how late the interrupt was
+   handled. */
+void pit_start_oneshot(uint16_t count) {
+  enum intr_level old_level;
+
+  ASSERT(count > 0);
+
+  old_level = intr_disable();
+  oneshot_count = count;
+  outb(PIT_PORT_CONTROL, 0x30); /* Channel 0, low byte then high byte, mode 0. */
+  outb(PIT_PORT_COUNTER(0), count);
+  outb(PIT_PORT_COUNTER(0), count >> 8);
+  intr_set_level(old_level);
+}
+
+/* Returns the number of PIT cycles since the last call to
+   pit_start_oneshot().  Correct as long as the count has not
+   wrapped around a second time, that is, for up to 65535 cycles
+   (about 55 ms) after the one-shot expired. */
+uint32_t pit_oneshot_elapsed(void) {
+  uint8_t status;
+  uint16_t count;
+  enum intr_level old_level;
+
+  /* Latch and read back channel 0's status byte and count. */
+  old_level = intr_disable();
+  outb(PIT_PORT_CONTROL, 0xc2);
+  status = inb(PIT_PORT_COUNTER(0));
+  count = inb(PIT_PORT_COUNTER(0));
+  count |= inb(PIT_PORT_COUNTER(0)) << 8;
+  intr_set_level(old_level);
+
+  if (status & 0x40) {
+    /* "Null count": the new count has not been loaded yet. */
+    return 0;
+  } else if (status & 0x80) {
+    /* Output is high, so the count expired and wrapped. */
+    return oneshot_count + (uint16_t)(0 - count);
+  } else
+    return oneshot_count - count;
+}
@@ -3,6 +3,11 @@
 
 #include <stdint.h>
 
+/* PIT cycles per second. */
+#define PIT_HZ 1193180
+
 void pit_configure_channel(int channel, int mode, int frequency);
+void pit_start_oneshot(uint16_t count);
+uint32_t pit_oneshot_elapsed(void);
 
 #endif /* devices/pit.h */
@@ -0,0 +1,165 @@
+#include "devices/raid0.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/bio.h"
+#include "devices/block.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+
+/* A RAID-0 ("striped") block device.
+
+   The device's sectors are divided into chunks of CHUNK_SECTORS
+   sectors, which are dealt out to the member devices in turn:
+   chunk 0 goes to the first member, chunk 1 to the second, and
+   so on, wrapping around after the last.  A large request thus
+   keeps every member busy at once, and when the members are on
+   different IDE channels their transfers overlap. */
+
+/* Sectors per chunk. */
+#define CHUNK_SECTORS 8
+
+/* Most member devices in an array. */
+#define MAX_MEMBERS 4
+
+/* The array. */
+struct raid0 {
+  struct block* members[MAX_MEMBERS]; /* Member devices. */
+  size_t member_cnt;                  /* Number of members. */
+};
+
+static struct raid0 md;
+
+/* A request to the array, split into one request per chunk. */
+struct raid0_request {
+  struct list_elem elem; /* Element in finished_requests. */
+  struct bio* parent;    /* The request to the array. */
+  size_t pending;        /* Number of CHILDREN not yet complete. */
+  struct bio children[]; /* Requests to the members. */
+};
+
+/* Requests whose children have all completed.  They are freed by
+   the next call to raid0_submit(), because the last child
+   completes in an interrupt handler, where we may not call
+   free().  Only touched with interrupts off. */
+static struct list finished_requests;
+
+static struct block_operations raid0_operations;
+
+static void child_done(struct bio*);
+
+/* Creates block device "md0" as a RAID-0 array of the block
+   devices named in MEMBERS, a comma-separated list such as
+   "hdb,hdd". */
+void raid0_init(const char* members) {
+  char names[64];
+  char *name, *save_ptr;
+  block_sector_t member_size = 0;
+  char extra_info[64];
+  size_t i;
+
+  list_init(&finished_requests);
+
+  strlcpy(names, members, sizeof names);
+  for (name = strtok_r(names, ",", &save_ptr); name != NULL;
+       name = strtok_r(NULL, ",", &save_ptr)) {
+    struct block* block = block_get_by_name(name);
+    if (block == NULL)
+      PANIC("raid0: no block device named \"%s\"", name);
+    if (md.member_cnt >= MAX_MEMBERS)
+      PANIC("raid0: more than %d member devices", MAX_MEMBERS);
+    for (i = 0; i < md.member_cnt; i++)
+      if (md.members[i] == block)
+        PANIC("raid0: %s listed twice", name);
+    if (md.member_cnt == 0 || block_size(block) < member_size)
+      member_size = block_size(block);
+    md.members[md.member_cnt++] = block;
+  }
+  if (md.member_cnt < 2)
+    PANIC("raid0: need at least 2 member devices");
+
+  /* Only whole chunks of the smallest member are used. */
+  member_size -= member_size % CHUNK_SECTORS;
+
+  snprintf(extra_info, sizeof extra_info, "raid0 of %zu devices, %d-sector chunks",
+           md.member_cnt, CHUNK_SECTORS);
+  block_register("md0", BLOCK_RAW, extra_info, member_size * md.member_cnt, &raid0_operations,
+                 &md);
+}
+
+/* Splits BIO, a request for array MD_, into one request per
+   chunk it touches and submits each of those to the member that
+   holds the chunk.  BIO completes when all of them have. */
+static void raid0_submit(void* md_, struct bio* bio) {
+  struct raid0* md = md_;
+  block_sector_t first = bio->sector / CHUNK_SECTORS;
+  block_sector_t last = (bio->sector + bio->cnt - 1) / CHUNK_SECTORS;
+  size_t child_cnt = last - first + 1;
+  struct raid0_request* r;
+  block_sector_t sector = bio->sector;
+  uint8_t* buffer = bio->buffer;
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT(!intr_context());
+
+  /* Free finished requests. */
+  old_level = intr_disable();
+  while (!list_empty(&finished_requests)) {
+    r = list_entry(list_pop_front(&finished_requests), struct raid0_request, elem);
+    intr_set_level(old_level);
+    free(r);
+    old_level = intr_disable();
+  }
+  intr_set_level(old_level);
+
+  r = malloc(sizeof *r + child_cnt * sizeof *r->children);
+  if (r == NULL)
+    PANIC("raid0: out of memory");
+  r->parent = bio;
+  r->pending = child_cnt;
+
+  for (i = 0; i < child_cnt; i++) {
+    block_sector_t chunk = sector / CHUNK_SECTORS;
+    block_sector_t ofs = sector % CHUNK_SECTORS;
+    size_t cnt = CHUNK_SECTORS - ofs;
+    block_sector_t member_sector = chunk / md->member_cnt * CHUNK_SECTORS + ofs;
+    struct bio* child = &r->children[i];
+
+    if (cnt > bio->sector + bio->cnt - sector)
+      cnt = bio->sector + bio->cnt - sector;
+    bio_init(child, member_sector, cnt, buffer, bio->write);
+    child->done = child_done;
+    child->aux = r;
+    sector += cnt;
+    buffer += cnt * BLOCK_SECTOR_SIZE;
+  }
+
+  /* Once the last child is submitted, R may complete and be
+     freed at any time, so it must not be touched afterward. */
+  for (i = 0; i < child_cnt; i++) {
+    struct block* member = md->members[(first + i) % md->member_cnt];
+    block_submit(member, &r->children[i]);
+  }
+}
+
+static struct block_operations raid0_operations = {.submit = raid0_submit};
+
+/* Completion callback for CHILD, part of a request to the
+   array.  Completes the whole request once all of its children
+   have completed. */
+static void child_done(struct bio* child) {
+  struct raid0_request* r = child->aux;
+  enum intr_level old_level = intr_disable();
+
+  ASSERT(r->pending > 0);
+  if (--r->pending == 0) {
+    /* Once R is on finished_requests, raid0_submit() may free
+       it, so fetch the parent first. */
+    struct bio* parent = r->parent;
+    list_push_back(&finished_requests, &r->elem);
+    block_complete(parent);
+  }
+  intr_set_level(old_level);
+}
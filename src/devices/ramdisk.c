@@ -0,0 +1,69 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device kept in kernel memory.
+
+   Transfers are plain memory copies, so a file system on a RAM
+   disk shows the CPU cost of the file system code itself,
+   without the time spent waiting for (emulated) IDE hardware.
+   Its contents are lost at shutdown. */
+
+static struct block_operations ramdisk_operations;
+
+/* Registers block device "ramdisk", backed by KB kilobytes of
+   zeroed memory (rounded up to a whole page) from the kernel
+   pool.  The kernel pool gets about half of RAM, so with the
+   default 4 MB of RAM a RAM disk can be at most about 1.5 MB,
+   less what the kernel itself needs.  If the disk does not fit,
+   prints a message and registers nothing; user pages are never
+   taken, since user processes would then run short. */
+void ramdisk_init(size_t kb) {
+  size_t page_cnt = DIV_ROUND_UP(kb * 1024, PGSIZE);
+  void* base;
+
+  if (page_cnt == 0)
+    PANIC("ramdisk: size must be at least 1 kB");
+  base = palloc_get_multiple(PAL_ZERO, page_cnt);
+  if (base == NULL) {
+    printf("ramdisk: %zu kB does not fit in the kernel pool, not registered\n", kb);
+    return;
+  }
+  block_register("ramdisk", BLOCK_RAW, "RAM disk", page_cnt * (PGSIZE / BLOCK_SECTOR_SIZE),
+                 &ramdisk_operations, base);
+}
+
+/* Reads CNT sectors starting at SECTOR from the RAM disk at BASE
+   into BUFFER. */
+static void ramdisk_read_multiple(void* base, block_sector_t sector, size_t cnt, void* buffer) {
+  memcpy(buffer, (uint8_t*)base + sector * BLOCK_SECTOR_SIZE, cnt * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes CNT sectors starting at SECTOR to the RAM disk at BASE
+   from BUFFER. */
+static void ramdisk_write_multiple(void* base, block_sector_t sector, size_t cnt,
+                                   const void* buffer) {
+  memcpy((uint8_t*)base + sector * BLOCK_SECTOR_SIZE, buffer, cnt * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads sector SECTOR from the RAM disk at BASE into BUFFER. */
+static void ramdisk_read(void* base, block_sector_t sector, void* buffer) {
+  ramdisk_read_multiple(base, sector, 1, buffer);
+}
+
+/* Writes sector SECTOR to the RAM disk at BASE from BUFFER. */
+static void ramdisk_write(void* base, block_sector_t sector, const void* buffer) {
+  ramdisk_write_multiple(base, sector, 1, buffer);
+}
+
+static struct block_operations ramdisk_operations = {
+    .read = ramdisk_read,
+    .write = ramdisk_write,
+    .read_multiple = ramdisk_read_multiple,
+    .write_multiple = ramdisk_write_multiple,
+};
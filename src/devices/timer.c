@@ -20,24 +20,98 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Number of timer interrupts handled. */
+static int64_t interrupt_cnt;
+
+/* PIT cycles per timer tick. */
+#define PIT_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Tickless mode.
+
+   Normally the PIT interrupts TIMER_FREQ times a second.  In
+   tickless mode it is instead programmed, one interrupt at a
+   time, for the next moment anything needs doing: the next tick
+   while a thread is running, so that time slices still end on
+   time, or the earliest wake-up time of a sleeping thread.  An
+   idle CPU is then only interrupted when a thread is due to wake
+   up, and a thread can sleep for less than a tick without busy
+   waiting.  Time is kept in PIT cycles, by adding up the lengths
+   of the one-shot intervals. */
+static bool tickless_requested; /* -tickless given? */
+static bool tickless;           /* Tickless mode in effect? */
+static uint64_t clock_base;     /* PIT cycles since boot when the one-shot started. */
+static uint64_t oneshot_end;    /* PIT cycles since boot when it will expire. */
+
+/* Bounds on a one-shot interval, in PIT cycles.  The lower bound
+   keeps us from programming an interrupt that would arrive
+   before we could return from the current one. */
+#define MIN_ONESHOT 12
+#define MAX_ONESHOT 65535
+
+/* Sleeping threads, in a hierarchical timing wheel keyed by
+   the tick in which each thread wakes up.
+
+   Level 0 has one slot for each of the WHEEL_SLOTS ticks
+   starting at wheel_tick.  Each slot of level 1 covers
+   WHEEL_SLOTS ticks, each slot of level 2 covers WHEEL_SLOTS
+   level-1 slots, and so on.  A thread goes into the lowest level
+   whose span reaches its wake-up tick, which takes constant
+   time.  Whenever wheel_tick crosses the boundary of a level-N
+   slot, the threads in the next level-N slot are "cascaded":
+   redistributed into the lower levels, which now reach them.
+   Each thread is cascaded at most WHEEL_LEVELS - 1 times, so
+   expiry also takes amortized constant time per thread.
+
+   A thread's slot only determines the tick in which it wakes;
+   in tickless mode it wakes at its exact wake-up time within
+   that tick. */
+#define WHEEL_BITS 5
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 6
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint32_t wheel_used[WHEEL_LEVELS]; /* Bit I set if slot I is nonempty. */
+static int64_t wheel_tick;                /* Level 0, slot 0 is this tick. */
+
+/* Longest time, in CPU cycles, that the timer code has kept
+   interrupts off while managing sleeping threads. */
+static uint64_t max_intr_off;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Time-stamp counter rate, in cycles per second, and its value
+   at calibration, when timer_ns() starts counting.  Initialized
+   by timer_calibrate(). */
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+
+/* Number of ticks timer_calibrate() times the TSC over. */
+#define TSC_CALIBRATION_TICKS 5
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
 static void real_time_delay(int64_t num, int32_t denom);
-static list_less_func time_comparator; // added
-static struct list sleeping_threads;   // added
+static uint64_t pit_clock(void);
+static void sleep_until(uint64_t wakeup);
+static void wheel_insert(struct thread*);
+static void wheel_expire(uint64_t now);
+static void wheel_cascade(int level);
+static bool wheel_next(uint64_t* wakeup);
+static void note_intr_off(uint64_t start);
+static uint64_t next_event(bool idle);
+static void oneshot_program(uint64_t deadline);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void timer_init(void) {
   pit_configure_channel(0, 2, TIMER_FREQ);
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
-  list_init(&sleeping_threads); // added
+  for (int level = 0; level < WHEEL_LEVELS; level++)
+    for (int slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init(&wheel[level][slot]);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -62,12 +136,39 @@ void timer_calibrate(void) {
       loops_per_tick |= test_bit;
 
   printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+
+  /* Count TSC cycles over a few whole ticks, whose length we know
+     exactly in PIT cycles. */
+  int64_t start = ticks;
+  while (ticks == start)
+    barrier();
+  start = ticks;
+  uint64_t tsc_start = timer_cycles();
+  while (ticks < start + TSC_CALIBRATION_TICKS)
+    barrier();
+  tsc_base = timer_cycles();
+  tsc_hz = (tsc_base - tsc_start) * PIT_HZ / (TSC_CALIBRATION_TICKS * PIT_PER_TICK);
+  printf("TSC runs at %'" PRIu64 " Hz.\n", tsc_hz);
+
+  /* Calibration needs periodic ticks, so tickless mode can only
+     start now. */
+  if (tickless_requested) {
+    enum intr_level old_level = intr_disable();
+    clock_base = oneshot_end = ticks * PIT_PER_TICK;
+    tickless = true;
+    oneshot_program(next_event(false));
+    intr_set_level(old_level);
+  }
 }
 
+/* Requests tickless mode, which starts at the end of
+   timer_calibrate(). */
+void timer_enable_tickless(void) { tickless_requested = true; }
+
 /* Returns the number of timer ticks since the OS booted. */
 int64_t timer_ticks(void) {
   enum intr_level old_level = intr_disable();
-  int64_t t = ticks;
+  int64_t t = tickless ? (int64_t)(pit_clock() / PIT_PER_TICK) : ticks;
   intr_set_level(old_level);
   return t;
 }
@@ -76,24 +177,53 @@ int64_t timer_ticks(void) {
    should be a value once returned by timer_ticks(). */
 int64_t timer_elapsed(int64_t then) { return timer_ticks() - then; }
 
-static bool time_comparator(const struct list_elem* t1, const struct list_elem* t2,
-                            void* aux UNUSED) {
-  struct thread* a = list_entry(t1, struct thread, elem);
-  struct thread* b = list_entry(t2, struct thread, elem);
-  return (a->time < b->time);
+/* Returns the number of CPU cycles counted by the time-stamp
+   counter since the CPU was reset.  Much finer-grained than
+   timer_ticks(), but its rate depends on the CPU. */
+uint64_t timer_cycles(void) {
+  uint64_t tsc;
+  asm volatile("rdtsc" : "=A"(tsc));
+  return tsc;
+}
+
+/* Returns the number of nanoseconds since timer_calibrate(),
+   measured with the time-stamp counter.  Much finer-grained than
+   timer_ticks(), and cheap enough to call on every operation
+   being profiled.  Returns 0 before calibration. */
+uint64_t timer_ns(void) { return timer_cycles_to_ns(timer_cycles() - tsc_base); }
+
+/* Converts CYCLES, a difference between two timer_cycles()
+   values, into nanoseconds.  Returns 0 before calibration. */
+uint64_t timer_cycles_to_ns(uint64_t cycles) {
+  if (tsc_hz == 0)
+    return 0;
+
+  /* Split the conversion so that the multiplication cannot
+     overflow. */
+  return cycles / tsc_hz * 1000000000 + cycles % tsc_hz * 1000000000 / tsc_hz;
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void timer_sleep(int64_t ticks) {
-  if (ticks == 0) {
+  if (ticks <= 0) {
     return;
   }
-  int64_t start = timer_ticks();
+  sleep_until((timer_ticks() + ticks) * PIT_PER_TICK);
+}
+
+/* Blocks the running thread until the PIT clock reaches WAKEUP. */
+static void sleep_until(uint64_t wakeup) {
   struct thread* curr_thread = thread_current();
-  curr_thread->time = start + ticks;
   enum intr_level curr_iframe = intr_disable();
-  list_insert_ordered(&sleeping_threads, &curr_thread->elem, time_comparator, NULL);
+  uint64_t start = timer_cycles();
+  curr_thread->time = wakeup;
+  wheel_insert(curr_thread);
+
+  /* Move the next interrupt up if we have to wake sooner. */
+  if (tickless && wakeup < oneshot_end)
+    oneshot_program(wakeup);
+  note_intr_off(start);
   thread_block();
   intr_set_level(curr_iframe);
 }
@@ -138,27 +268,208 @@ void timer_udelay(int64_t us) { real_time_delay(us, 1000 * 1000); }
 void timer_ndelay(int64_t ns) { real_time_delay(ns, 1000 * 1000 * 1000); }
 
 /* Prints timer statistics. */
-void timer_print_stats(void) { printf("Timer: %" PRId64 " ticks\n", timer_ticks()); }
+void timer_print_stats(void) {
+  printf("Timer: %" PRId64 " ticks, %" PRId64 " interrupts%s, %" PRIu64
+         " cycles max with interrupts off\n",
+         timer_ticks(), interrupt_cnt, tickless ? " (tickless)" : "", max_intr_off);
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, puts off the next timer
+   interrupt until a sleeping thread needs to wake up. */
+void timer_idle_enter(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  if (tickless)
+    oneshot_program(next_event(true));
+}
+
+/* Called by the idle thread, with interrupts off, after an
+   interrupt wakes the CPU.  In tickless mode, brings the next
+   timer interrupt back to the next tick, in case a thread is
+   about to run and will need preempting. */
+void timer_idle_exit(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  if (tickless)
+    oneshot_program(next_event(false));
+}
 
 /* Timer interrupt handler. */
 static void timer_interrupt(struct intr_frame* args UNUSED) {
+  uint64_t start = timer_cycles();
+
   ASSERT(intr_context());
-  ticks++;
-  struct list_elem* e = list_begin(&sleeping_threads);
-  while (
-      e !=
-      list_end(
-          &sleeping_threads)) { // doesnt work if null? don't remove the last thread / first thread you enter
-    struct thread* curr_thread = list_entry(e, struct thread, elem);
-    if (curr_thread->time > ticks) {
+  interrupt_cnt++;
+
+  /* Account for every tick that has passed.  In tickless mode
+     there may be several, or none. */
+  if (tickless) {
+    int64_t now_ticks = pit_clock() / PIT_PER_TICK;
+    while (ticks < now_ticks) {
+      thread_tick(++ticks);
+    }
+  } else {
+    thread_tick(++ticks);
+  }
+
+  wheel_expire(tickless ? pit_clock() : (uint64_t)ticks * PIT_PER_TICK);
+
+  if (tickless)
+    oneshot_program(next_event(false));
+  note_intr_off(start);
+}
+
+/* Returns the number of PIT cycles since the OS booted.  Must be
+   called with interrupts off, in tickless mode. */
+static uint64_t pit_clock(void) { return clock_base + pit_oneshot_elapsed(); }
+
+/* Returns the PIT clock value at which the next timer interrupt
+   is needed: the earliest wake-up time of a sleeping thread, or
+   the next tick if it is sooner and the CPU is not IDLE. */
+static uint64_t next_event(bool idle) {
+  uint64_t deadline = idle ? UINT64_MAX : (pit_clock() / PIT_PER_TICK + 1) * PIT_PER_TICK;
+  uint64_t wakeup;
+
+  if (wheel_next(&wakeup) && wakeup < deadline)
+    deadline = wakeup;
+  return deadline;
+}
+
+/* Adds T, whose wake-up time has been set, to the timing wheel. */
+static void wheel_insert(struct thread* t) {
+  int64_t tick = (uint64_t)t->time / PIT_PER_TICK;
+  int64_t delta;
+  int level;
+
+  /* A thread that is already due goes in the current slot. */
+  if (tick < wheel_tick)
+    tick = wheel_tick;
+
+  /* Find the lowest level that reaches TICK.  A tick beyond the
+     top level's span goes in its farthest slot, and is
+     cascaded back into it until it comes within reach. */
+  delta = tick - wheel_tick;
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t)1 << (WHEEL_BITS * (level + 1)))
       break;
+  if (delta >= (int64_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+    tick = wheel_tick + ((int64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+  int slot = (tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+  list_push_back(&wheel[level][slot], &t->elem);
+  wheel_used[level] |= 1u << slot;
+}
+
+/* Wakes up every sleeping thread whose wake-up time is at or
+   before NOW, in PIT cycles, advancing the timing wheel to the
+   current tick. */
+static void wheel_expire(uint64_t now) {
+  int64_t now_tick = now / PIT_PER_TICK;
+
+  for (;;) {
+    int slot = wheel_tick & (WHEEL_SLOTS - 1);
+    struct list* list = &wheel[0][slot];
+    struct list_elem* e = list_begin(list);
+
+    while (e != list_end(list)) {
+      struct thread* t = list_entry(e, struct thread, elem);
+      e = list_next(e);
+      if ((uint64_t)t->time <= now) {
+        list_remove(&t->elem);
+        thread_unblock(t);
+      }
+    }
+    if (list_empty(list))
+      wheel_used[0] &= ~(1u << slot);
+
+    /* Stay in the current tick: in tickless mode, threads in its
+       slot may not be due yet. */
+    if (wheel_tick >= now_tick)
+      break;
+    wheel_tick++;
+    if ((wheel_tick & (WHEEL_SLOTS - 1)) == 0)
+      wheel_cascade(1);
+  }
+}
+
+/* Called when wheel_tick reaches the start of a slot at LEVEL.
+   Moves the threads in that slot into the lower levels, first
+   cascading the level above if its slot boundary was also
+   reached. */
+static void wheel_cascade(int level) {
+  int slot = (wheel_tick >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+  struct list* list = &wheel[level][slot];
+
+  if (slot == 0 && level + 1 < WHEEL_LEVELS)
+    wheel_cascade(level + 1);
+
+  wheel_used[level] &= ~(1u << slot);
+  while (!list_empty(list))
+    wheel_insert(list_entry(list_pop_front(list), struct thread, elem));
+}
+
+/* If any thread is sleeping, stores into *WAKEUP a PIT clock
+   value at which a timer interrupt is needed, no later than the
+   earliest wake-up time, and returns true.  Otherwise, returns
+   false. */
+static bool wheel_next(uint64_t* wakeup) {
+  bool found = false;
+  int level;
+
+  if (wheel_used[0] != 0) {
+    /* Find the first nonempty slot, counting circularly from the
+       current tick's slot, then the earliest thread in it. */
+    int cur = wheel_tick & (WHEEL_SLOTS - 1);
+    uint32_t used = cur == 0 ? wheel_used[0]
+                             : (wheel_used[0] >> cur) | (wheel_used[0] << (WHEEL_SLOTS - cur));
+    int slot = (cur + __builtin_ctz(used)) & (WHEEL_SLOTS - 1);
+    struct list* list = &wheel[0][slot];
+    struct list_elem* e;
+
+    *wakeup = UINT64_MAX;
+    for (e = list_begin(list); e != list_end(list); e = list_next(e)) {
+      struct thread* t = list_entry(e, struct thread, elem);
+      if ((uint64_t)t->time < *wakeup)
+        *wakeup = t->time;
     }
-    struct list_elem* temp = e; // temporary variable to remove the thread if
-    e = list_next(e);
-    list_remove(temp);
-    thread_unblock(curr_thread);
-    thread_tick();
+    found = true;
   }
+
+  /* A thread in a higher level may be due before any in level
+     0, but not before the next cascade. */
+  for (level = 1; level < WHEEL_LEVELS; level++)
+    if (wheel_used[level] != 0) {
+      uint64_t cascade = ((wheel_tick >> WHEEL_BITS) + 1) * WHEEL_SLOTS * PIT_PER_TICK;
+      if (!found || cascade < *wakeup)
+        *wakeup = cascade;
+      found = true;
+      break;
+    }
+  return found;
+}
+
+/* Records that interrupts have been off since time-stamp counter
+   value START. */
+static void note_intr_off(uint64_t start) {
+  uint64_t elapsed = timer_cycles() - start;
+  if (elapsed > max_intr_off)
+    max_intr_off = elapsed;
+}
+
+/* Programs the PIT to interrupt at PIT clock value DEADLINE, or
+   as close to it as a one-shot interval allows. */
+static void oneshot_program(uint64_t deadline) {
+  uint64_t now = pit_clock();
+  uint64_t delta = deadline > now ? deadline - now : 0;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (delta < MIN_ONESHOT)
+    delta = MIN_ONESHOT;
+  else if (delta > MAX_ONESHOT)
+    delta = MAX_ONESHOT;
+  clock_base = now;
+  oneshot_end = now + delta;
+  pit_start_oneshot(delta);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -201,7 +512,17 @@ static void real_time_sleep(int64_t num, int32_t denom) {
   int64_t ticks = num * TIMER_FREQ / denom;
 
   ASSERT(intr_get_level() == INTR_ON);
-  if (ticks > 0) {
+  if (tickless) {
+    /* The timer can interrupt at any moment, so sleep for
+         exactly as long as requested. */
+    uint64_t cycles = num * PIT_HZ / denom;
+    if (cycles > 0) {
+      enum intr_level old_level = intr_disable();
+      uint64_t wakeup = pit_clock() + cycles;
+      intr_set_level(old_level);
+      sleep_until(wakeup);
+    }
+  } else if (ticks > 0) {
     /* We're waiting for at least one full timer tick.  Use
          timer_sleep() because it will yield the CPU to other
          processes. */
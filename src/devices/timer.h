@@ -12,6 +12,9 @@ void timer_calibrate(void);
 
 int64_t timer_ticks(void);
 int64_t timer_elapsed(int64_t);
+uint64_t timer_cycles(void);
+uint64_t timer_ns(void);
+uint64_t timer_cycles_to_ns(uint64_t cycles);
 
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep(int64_t ticks);
@@ -26,4 +29,9 @@ void timer_ndelay(int64_t nanoseconds);
 
 void timer_print_stats(void);
 
+/* Tickless mode. */
+void timer_enable_tickless(void);
+void timer_idle_enter(void);
+void timer_idle_exit(void);
+
 #endif /* devices/timer.h */
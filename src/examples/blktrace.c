@@ -0,0 +1,20 @@
+/* blktrace.c
+
+   Prints the block requests that the kernel has traced since the
+   last time the trace was read, one per line, as
+   DEVICE OP SECTOR COUNT LATENCY, where OP is R or W and LATENCY
+   is in CPU cycles.  The kernel must be run with -blktrace. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+int main(void) {
+  struct blktrace_entry buf[32];
+  int cnt, i;
+
+  while ((cnt = blktrace(buf, sizeof buf / sizeof *buf)) > 0)
+    for (i = 0; i < cnt; i++)
+      printf("%s %c %u %u %llu\n", buf[i].device, buf[i].write ? 'W' : 'R', buf[i].sector,
+             buf[i].cnt, buf[i].latency);
+  return EXIT_SUCCESS;
+}
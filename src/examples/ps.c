@@ -0,0 +1,50 @@
+/* ps.c
+
+   Lists every thread with its CPU accounting, one per line, as
+   TID PID STATE PRI TICKS VOL INVOL WAITS AVG-WAIT MAX-WAIT NAME,
+   where the wait times are the time spent in a ready queue, in
+   microseconds.  Then prints the ticks used by each process,
+   summed over its threads. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+#define MAX_THREADS 64
+
+int main(void) {
+  static struct threadstat ts[MAX_THREADS];
+  int cnt, i, j;
+
+  cnt = threadstat(ts, MAX_THREADS);
+  if (cnt < 0) {
+    printf("ps: threadstat failed\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("  TID   PID S PRI    TICKS    VOL  INVOL  WAITS  AVG-WAIT  MAX-WAIT NAME\n");
+  for (i = 0; i < cnt; i++) {
+    struct threadstat* t = &ts[i];
+    uint64_t avg = t->wait_cnt > 0 ? t->wait_total_ns / t->wait_cnt : 0;
+
+    printf("%5d %5d %c %3d %8llu %6u %6u %6u %9llu %9llu %s\n", t->tid, t->pid, t->state,
+           t->priority, t->run_ticks, t->voluntary, t->involuntary, t->wait_cnt, avg / 1000,
+           t->wait_max_ns / 1000, t->name);
+  }
+
+  printf("\n  PID    TICKS\n");
+  for (i = 0; i < cnt; i++) {
+    uint64_t ticks = 0;
+
+    /* Print each process once, at its first thread. */
+    for (j = 0; j < i; j++)
+      if (ts[j].pid == ts[i].pid)
+        break;
+    if (ts[i].pid == 0 || j < i)
+      continue;
+    for (j = i; j < cnt; j++)
+      if (ts[j].pid == ts[i].pid)
+        ticks += ts[j].run_ticks;
+    printf("%5d %8llu\n", ts[i].pid, ticks);
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,9 +1,11 @@
 #include <string.h>
+#include <debug.h>
 #include "filesys/cache.h"
 #include "threads/synch.h"
 #include "filesys/filesys.h"
 #include "devices/block.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 
 #define MAX_CACHE_CAPACITY 64
 
@@ -12,8 +14,19 @@ unsigned clock_hand;                          // Position of clock hand in cache
 size_t misses;
 size_t hits;
 struct lock cache_lock;
+static uint8_t* flush_buf; // Staging area for writing a run of blocks at once
+
+/* Group commit for cache_sync().  Each request takes a
+   generation number; one thread at a time flushes on behalf of
+   every request made before it started. */
+static struct lock sync_lock;       /* Protects the fields below. */
+static struct condition sync_done;  /* Signaled when a flush finishes. */
+static unsigned sync_requested;     /* Generation of the newest request. */
+static unsigned sync_completed;     /* Newest generation known to be on disk. */
+static bool sync_active;            /* Whether a flush is in progress. */
 
 static struct entry* cache_access(void);
+static void cache_store(block_sector_t sector, const void* buf, bool pin);
 
 /* Initializes the cache. */
 void cache_init(void) {
@@ -23,6 +36,7 @@ void cache_init(void) {
     e = &cache_array[i];
     e->valid = false;
     e->dirty = false;
+    e->pinned = false;
     lock_init(&e->entry_lock);
   }
   // Initialize clock_hand to start at the first position, and other data
@@ -30,24 +44,85 @@ void cache_init(void) {
   misses = 0;
   hits = 0;
   lock_init(&cache_lock);
+  lock_init(&sync_lock);
+  cond_init(&sync_done);
+  flush_buf = malloc(MAX_CACHE_CAPACITY * BLOCK_SECTOR_SIZE);
+  if (flush_buf == NULL)
+    PANIC("can't allocate cache flush buffer");
 }
 
-/* Iterate through cache and flush dirty blocks to disk. */
+/* Iterate through cache and flush dirty blocks to disk in
+   ascending sector order, so the disk sweeps across them once,
+   writing each run of consecutive sectors with one command.
+   Pinned blocks hold uncommitted journal data and are skipped. */
 void cache_flush(void) {
+  struct entry* dirty[MAX_CACHE_CAPACITY];
+  int dirty_cnt = 0;
+
   lock_acquire(&cache_lock);
-  struct entry* e;
   for (int i = 0; i < MAX_CACHE_CAPACITY; i++) {
-    e = &cache_array[i];
-    lock_acquire(&e->entry_lock);
-    if (e->valid && e->dirty) {
-      block_write(fs_device, e->sector, e->disk);
+    struct entry* e = &cache_array[i];
+    if (e->valid && e->dirty && !e->pinned) {
+      // Insertion sort by sector
+      int j = dirty_cnt++;
+      for (; j > 0 && dirty[j - 1]->sector > e->sector; j--)
+        dirty[j] = dirty[j - 1];
+      dirty[j] = e;
+    }
+  }
+  for (int i = 0; i < dirty_cnt;) {
+    int run = 1;
+    while (i + run < dirty_cnt && dirty[i + run]->sector == dirty[i]->sector + run)
+      run++;
+    for (int j = 0; j < run; j++) {
+      struct entry* e = dirty[i + j];
+      lock_acquire(&e->entry_lock);
+      memcpy(flush_buf + j * BLOCK_SECTOR_SIZE, e->disk, BLOCK_SECTOR_SIZE);
       e->dirty = false;
+      lock_release(&e->entry_lock);
     }
-    lock_release(&e->entry_lock);
+    block_write_multiple(fs_device, dirty[i]->sector, run, flush_buf);
+    i += run;
   }
   lock_release(&cache_lock);
 }
 
+/* Writes every dirty block to disk before returning, like
+   fsync().  Concurrent callers are batched: the first becomes
+   the leader, gives other ready threads a chance to join, and
+   then flushes once for all of them, while later callers wait
+   for that flush (or the next one, if it had already started)
+   and are woken together. */
+void cache_sync(void) {
+  unsigned gen;
+
+  lock_acquire(&sync_lock);
+  gen = ++sync_requested;
+  while ((int)(sync_completed - gen) < 0) {
+    if (sync_active) {
+      cond_wait(&sync_done, &sync_lock);
+      continue;
+    }
+
+    /* Lead the next flush. */
+    sync_active = true;
+    lock_release(&sync_lock);
+    thread_yield();
+
+    lock_acquire(&sync_lock);
+    unsigned batch = sync_requested;
+    lock_release(&sync_lock);
+
+    cache_flush();
+
+    lock_acquire(&sync_lock);
+    sync_completed = batch;
+    sync_active = false;
+    cond_broadcast(&sync_done, &sync_lock);
+  }
+  lock_release(&sync_lock);
+}
+
 /* Attempts to retrieve a free block in our cache and evicts via 
 clock algorithm if full. */
 static struct entry* cache_access(void) {
@@ -57,6 +132,7 @@ static struct entry* cache_access(void) {
         &cache_array[clock_hand]; // Current block that the clock hand is pointing at
     if (!curr->valid) {           // Can return invalid blocks
       return curr;
+    } else if (curr->pinned) { // Never evict uncommitted journal data
     } else if (curr->r_bit) { // Set R bit to false but don't evict initially as per clock algorithm
       curr->r_bit = false;
     } else {             // Evict otherwise
@@ -68,12 +144,37 @@ static struct entry* cache_access(void) {
       return curr;
     }
     // Increment clock hand or reset it if it reaches the last entry
-    clock_hand = clock_hand == MAX_CACHE_CAPACITY ? clock_hand++ : 0;
+    clock_hand = (clock_hand + 1) % MAX_CACHE_CAPACITY;
   }
 }
 
 /* Writes BUF to the cache for the given SECTOR. */
-void cache_write(block_sector_t sector, const void* buf) {
+void cache_write(block_sector_t sector, const void* buf) { cache_store(sector, buf, false); }
+
+/* Writes BUF to the cache for the given SECTOR and pins it there
+   until cache_unpin() is called: a pinned block is neither
+   evicted nor flushed, so it never reaches its home sector. */
+void cache_write_pinned(block_sector_t sector, const void* buf) {
+  cache_store(sector, buf, true);
+}
+
+/* Lets the block for SECTOR, which must be pinned in the cache,
+   be written back and evicted again. */
+void cache_unpin(block_sector_t sector) {
+  lock_acquire(&cache_lock);
+  for (int i = 0; i < MAX_CACHE_CAPACITY; i++) {
+    struct entry* e = &cache_array[i];
+    if (e->valid && e->sector == sector) {
+      e->pinned = false;
+      break;
+    }
+  }
+  lock_release(&cache_lock);
+}
+
+/* Writes BUF to the cache for the given SECTOR, pinning the
+   block if PIN is true.  An already pinned block stays pinned. */
+static void cache_store(block_sector_t sector, const void* buf, bool pin) {
   lock_acquire(&cache_lock);
   struct entry* e = NULL;
   struct entry* curr;
@@ -95,10 +196,12 @@ void cache_write(block_sector_t sector, const void* buf) {
     e->valid = true;
     e->sector = sector;
     e->r_bit = true;
+    e->pinned = pin;
     memcpy(e->disk, buf, BLOCK_SECTOR_SIZE);
   } else {
     e->r_bit = true;
     e->dirty = true;
+    e->pinned = e->pinned || pin;
     memcpy(e->disk, buf, BLOCK_SECTOR_SIZE);
   }
   lock_release(&cache_lock);
@@ -126,6 +229,7 @@ void cache_read(block_sector_t sector, void* buf) {
     misses++;
     e = cache_access(); // Find free block
     e->dirty = false;
+    e->pinned = false;
     e->valid = true;
     e->sector = sector;
     block_read(fs_device, sector, e->disk);
@@ -150,7 +254,8 @@ void cache_reset(void) {
 
   int i;
   for (i = 0; i < MAX_CACHE_CAPACITY; i++) {
-    cache_array[i].valid = false;
+    if (!cache_array[i].pinned) // Pinned blocks have not been written out
+      cache_array[i].valid = false;
   }
   /* Release the main cache lock */
   lock_release(&cache_lock);
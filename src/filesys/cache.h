@@ -12,14 +12,18 @@ struct entry {
   bool dirty;            /* Whether this entry is dirty. */
   block_sector_t sector; /* Disk sector this entry contains. Also the TAG. */
   bool r_bit;            /* Whether this entry has been recently used. For the clock algorithm. */
+  bool pinned;           /* Whether this entry holds uncommitted journal data. */
   uint8_t disk[BLOCK_SECTOR_SIZE]; /* Actual data. */
   struct lock entry_lock;          /* Lock to synchronize access to this entry. */
 };
 
 void cache_init(void);
 void cache_flush(void);
+void cache_sync(void);
 void cache_write(block_sector_t sector, const void* buf);
 void cache_read(block_sector_t sector, void* buf);
+void cache_write_pinned(block_sector_t sector, const void* buf);
+void cache_unpin(block_sector_t sector);
 void cache_reset(void);
 int get_cache_hit(void);
 int get_cache_miss(void);
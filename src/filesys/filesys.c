@@ -7,6 +7,7 @@
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
 #include "threads/thread.h"
 
@@ -30,6 +31,7 @@ void filesys_init(bool format) {
   inode_init();
   free_map_init();
   cache_init();
+  journal_init(format);
 
   if (format)
     do_format();
@@ -139,7 +141,7 @@ bool* parse_path(const char* path, char fn[NAME_MAX + 1], struct dir** dir) {
 /* Shuts down the file system module, writing any unwritten data
    to disk. */
 void filesys_done(void) {
-  cache_flush();
+  journal_checkpoint();
   free_map_close();
 }
 
@@ -173,12 +175,15 @@ bool filesys_create(const char* name, off_t initial_size, bool is_dir) {
   }
 
   /* Creating the file. */
+  journal_begin();
   bool success =
-      (parse_path(name, fn, &dir) && free_map_allocate(1, &inode_sector) &&
+      (parse_path(name, fn, &dir) &&
+       free_map_allocate(inode_get_inumber(dir_inode(dir)), 1, &inode_sector) &&
        inode_create(inode_sector, initial_size, is_dir) && dir_add(dir, fn, inode_sector));
 
   if (!success && inode_sector != 0)
     free_map_release(inode_sector, 1);
+  journal_end();
 
   dir_close(dir);
 
@@ -351,8 +356,10 @@ bool filesys_remove(const char* name) {
     }
   }
 
+  journal_begin();
   success = success && dir_remove(dir, fn);
   dir_close(dir);
+  journal_end();
   return success;
 }
 
@@ -1,45 +1,138 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+
+/* Number of sectors in each allocation group.  Like the cylinder
+   groups of the BSD fast file system, groups let us keep related
+   sectors close together and skip full regions of the disk
+   without looking at the bitmap. */
+#define GROUP_SECTORS 256
+
+/* Number of sectors summarized by each leaf of the free extent
+   index.  A group is covered by GROUP_LEAVES whole leaves, so its
+   summary is a node of the index, and an allocation only has to
+   re-read the leaves it touched. */
+#define LEAF_SECTORS 32
+#define GROUP_LEAVES (GROUP_SECTORS / LEAF_SECTORS)
 
 /* Free map of the disc. */
 static struct file* free_map_file; /* Free map file. */
 static struct bitmap* free_map;    /* Free map, one bit per sector. */
 
+/* Allocation groups. */
+static size_t group_cnt;   /* Number of allocation groups. */
+static size_t* group_free; /* Number of free sectors in each group. */
+
+/* Summary of the free space in a range of the disk.  The free
+   extent index is a segment tree of these with one leaf per
+   LEAF_SECTORS sectors, so the first run of N free sectors anywhere
+   on the disk can be found by walking down a single path instead
+   of testing the bitmap bit by bit. */
+struct extent_summary {
+  size_t len;  /* Number of sectors covered. */
+  size_t pre;  /* Free sectors at the start of the range. */
+  size_t suf;  /* Free sectors at the end of the range. */
+  size_t best; /* Longest run of free sectors in the range. */
+};
+
+static struct extent_summary* extent_tree; /* Root at index 1, leaves at leaf_base. */
+static size_t leaf_base;                   /* Index of the first leaf. */
+
+static void group_adjust(block_sector_t sector, size_t cnt, bool allocated);
+static void group_recount(void);
+static size_t group_scan(size_t group, size_t start, size_t cnt);
+static size_t range_scan(size_t start, size_t end, size_t cnt);
+static bool group_fits(size_t group, size_t cnt);
+static void extent_update(block_sector_t sector, size_t cnt);
+static void extent_leaf(size_t leaf);
+static void extent_merge(size_t node);
+static size_t extent_find(size_t node, size_t lo, size_t hi, size_t cnt);
+
 /* Initializes the free map. */
 void free_map_init(void) {
   free_map = bitmap_create(block_size(fs_device));
   if (free_map == NULL)
     PANIC("bitmap creation failed--file system device is too large");
+  group_cnt = DIV_ROUND_UP(bitmap_size(free_map), GROUP_SECTORS);
+  group_free = malloc(group_cnt * sizeof *group_free);
+  for (leaf_base = GROUP_LEAVES; leaf_base < group_cnt * GROUP_LEAVES; leaf_base *= 2)
+    continue;
+  extent_tree = calloc(2 * leaf_base, sizeof *extent_tree);
+  if (group_free == NULL || extent_tree == NULL)
+    PANIC("allocation group creation failed");
   bitmap_mark(free_map, FREE_MAP_SECTOR);
   bitmap_mark(free_map, ROOT_DIR_SECTOR);
+  if (JOURNAL_SECTOR + JOURNAL_SECTORS > bitmap_size(free_map))
+    PANIC("file system device is too small for the journal");
+  bitmap_set_multiple(free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+  group_recount();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  The search starts at GOAL, which
+   should be a sector the new ones will be read together with
+   (the owning inode or the file's last data block), then moves
+   outward through the allocation groups nearest to GOAL's.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
-bool free_map_allocate(size_t cnt, block_sector_t* sectorp) {
-  // Finds cnt consecutive 0 bits in bitmap, sets them to 1, gets index of the first sector
-  block_sector_t sector = bitmap_scan_and_flip(free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR && free_map_file != NULL && !bitmap_write(free_map, free_map_file)) {
+bool free_map_allocate(block_sector_t goal, size_t cnt, block_sector_t* sectorp) {
+  size_t sector = BITMAP_ERROR;
+
+  if (goal >= bitmap_size(free_map))
+    goal = 0;
+
+  if (cnt <= GROUP_SECTORS) {
+    size_t home = goal / GROUP_SECTORS;
+    size_t dist;
+
+    /* Try after GOAL first, then the rest of GOAL's group, then
+       alternate between the groups above and below it.  A group
+       is only scanned if its longest free run is long enough. */
+    if (group_fits(home, cnt)) {
+      sector = group_scan(home, goal, cnt);
+      if (sector == BITMAP_ERROR)
+        sector = group_scan(home, home * GROUP_SECTORS, cnt);
+    }
+    for (dist = 1; sector == BITMAP_ERROR && (dist <= home || home + dist < group_cnt); dist++) {
+      if (home + dist < group_cnt && group_fits(home + dist, cnt))
+        sector = group_scan(home + dist, (home + dist) * GROUP_SECTORS, cnt);
+      if (sector == BITMAP_ERROR && dist <= home && group_fits(home - dist, cnt))
+        sector = group_scan(home - dist, (home - dist) * GROUP_SECTORS, cnt);
+    }
+  }
+
+  /* Runs that straddle group boundaries come from the free
+     extent index. */
+  if (sector == BITMAP_ERROR) {
+    if (cnt == 0 || extent_tree[1].best < cnt)
+      return false;
+    sector = extent_find(1, 0, leaf_base, cnt);
+  }
+
+  bitmap_set_multiple(free_map, sector, cnt, true);
+  if (free_map_file != NULL && !bitmap_write(free_map, free_map_file)) {
     // Revert bitmap to previous state if failed to write updated bitmap to free_map_file
     bitmap_set_multiple(free_map, sector, cnt, false);
-    sector = BITMAP_ERROR;
+    return false;
   }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  group_adjust(sector, cnt, true);
+  *sectorp = sector;
+  return true;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void free_map_release(block_sector_t sector, size_t cnt) {
   ASSERT(bitmap_all(free_map, sector, cnt));
   bitmap_set_multiple(free_map, sector, cnt, false);
+  group_adjust(sector, cnt, false);
+  journal_revoke(sector, cnt);
   bitmap_write(free_map, free_map_file);
 }
 
@@ -50,6 +143,7 @@ void free_map_open(void) {
     PANIC("can't open free map");
   if (!bitmap_read(free_map, free_map_file))
     PANIC("can't read free map");
+  group_recount();
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -68,4 +162,163 @@ void free_map_create(void) {
     PANIC("can't open free map");
   if (!bitmap_write(free_map, free_map_file))
     PANIC("can't write free map");
-}
\ No newline at end of file
+}
+
+/* Updates the free counts of the groups covering the CNT sectors
+   starting at SECTOR, which were just ALLOCATED or released, and
+   the free extent index over those sectors. */
+static void group_adjust(block_sector_t sector, size_t cnt, bool allocated) {
+  block_sector_t start = sector;
+  size_t left = cnt;
+
+  while (left > 0) {
+    size_t group = sector / GROUP_SECTORS;
+    size_t group_end = (group + 1) * GROUP_SECTORS;
+    size_t n = group_end - sector < left ? group_end - sector : left;
+
+    if (allocated)
+      group_free[group] -= n;
+    else
+      group_free[group] += n;
+    sector += n;
+    left -= n;
+  }
+  extent_update(start, cnt);
+}
+
+/* Recomputes every group's free count and the whole free extent
+   index from the bitmap. */
+static void group_recount(void) {
+  size_t group, leaf, node;
+
+  for (group = 0; group < group_cnt; group++) {
+    size_t start = group * GROUP_SECTORS;
+    size_t end = start + GROUP_SECTORS;
+    if (end > bitmap_size(free_map))
+      end = bitmap_size(free_map);
+    group_free[group] = bitmap_count(free_map, start, end - start, false);
+  }
+
+  for (leaf = 0; leaf * LEAF_SECTORS < bitmap_size(free_map); leaf++)
+    extent_leaf(leaf);
+  for (node = leaf_base - 1; node > 0; node--)
+    extent_merge(node);
+}
+
+/* Returns the first sector at or after START of a run of CNT free
+   sectors that lies entirely within GROUP, or BITMAP_ERROR if
+   there is none.
+
+   bitmap_scan() skips allocated words whole and returns the start
+   of the first free run that is long enough.  If that run does not
+   fit before the end of GROUP, no later one within GROUP can. */
+static size_t group_scan(size_t group, size_t start, size_t cnt) {
+  return range_scan(start, (group + 1) * GROUP_SECTORS, cnt);
+}
+
+/* Returns the first sector at or after START of a run of CNT free
+   sectors that ends by END, or BITMAP_ERROR if there is none. */
+static size_t range_scan(size_t start, size_t end, size_t cnt) {
+  size_t sector;
+
+  if (end > bitmap_size(free_map))
+    end = bitmap_size(free_map);
+  if (start + cnt > end)
+    return BITMAP_ERROR;
+  sector = bitmap_scan(free_map, start, cnt, false);
+  return sector != BITMAP_ERROR && sector + cnt <= end ? sector : BITMAP_ERROR;
+}
+
+/* Returns true if GROUP contains a run of at least CNT free
+   sectors.  LEAF_BASE is a multiple of GROUP_LEAVES, so the node
+   covering exactly GROUP's leaves is GROUP_LEAVES times closer to
+   the root than its first leaf. */
+static bool group_fits(size_t group, size_t cnt) {
+  return extent_tree[leaf_base / GROUP_LEAVES + group].best >= cnt;
+}
+
+/* Recomputes the leaves of the free extent index that cover the
+   CNT sectors starting at SECTOR from the bitmap, and then only
+   the nodes above them. */
+static void extent_update(block_sector_t sector, size_t cnt) {
+  size_t lo, hi, node;
+
+  if (cnt == 0)
+    return;
+
+  lo = sector / LEAF_SECTORS;
+  hi = (sector + cnt - 1) / LEAF_SECTORS;
+  for (node = lo; node <= hi; node++)
+    extent_leaf(node);
+  for (lo = (leaf_base + lo) / 2, hi = (leaf_base + hi) / 2; lo > 0; lo /= 2, hi /= 2)
+    for (node = lo; node <= hi; node++)
+      extent_merge(node);
+}
+
+/* Recomputes the summary of LEAF of the free extent index from
+   the bitmap. */
+static void extent_leaf(size_t leaf) {
+  struct extent_summary* s = &extent_tree[leaf_base + leaf];
+  size_t start = leaf * LEAF_SECTORS;
+  size_t end = start + LEAF_SECTORS;
+  size_t run = 0;
+  size_t free_cnt, i;
+
+  if (end > bitmap_size(free_map))
+    end = bitmap_size(free_map);
+  s->len = end - start;
+
+  /* Most leaves are entirely free or entirely allocated. */
+  free_cnt = bitmap_count(free_map, start, s->len, false);
+  if (free_cnt == 0 || free_cnt == s->len) {
+    s->pre = s->suf = s->best = free_cnt;
+    return;
+  }
+
+  s->pre = s->best = 0;
+  for (i = start; i < end; i++) {
+    if (bitmap_test(free_map, i)) {
+      run = 0;
+      continue;
+    }
+    if (++run > s->best)
+      s->best = run;
+    if (run == i - start + 1)
+      s->pre = run;
+  }
+  s->suf = run;
+}
+
+/* Recomputes the summary of interior NODE of the free extent
+   index from its children. */
+static void extent_merge(size_t node) {
+  struct extent_summary* s = &extent_tree[node];
+  const struct extent_summary* l = &extent_tree[2 * node];
+  const struct extent_summary* r = &extent_tree[2 * node + 1];
+
+  s->len = l->len + r->len;
+  s->pre = l->pre == l->len ? l->len + r->pre : l->pre;
+  s->suf = r->suf == r->len ? r->len + l->suf : r->suf;
+  s->best = l->best > r->best ? l->best : r->best;
+  if (l->suf + r->pre > s->best)
+    s->best = l->suf + r->pre;
+}
+
+/* Returns the first sector of the lowest run of CNT free sectors
+   within NODE of the free extent index, which covers leaves LO
+   up to HI and must contain such a run. */
+static size_t extent_find(size_t node, size_t lo, size_t hi, size_t cnt) {
+  size_t mid = lo + (hi - lo) / 2;
+  const struct extent_summary* l = &extent_tree[2 * node];
+  const struct extent_summary* r = &extent_tree[2 * node + 1];
+
+  ASSERT(extent_tree[node].best >= cnt);
+
+  if (hi - lo == 1)
+    return range_scan(lo * LEAF_SECTORS, hi * LEAF_SECTORS, cnt);
+  if (l->best >= cnt)
+    return extent_find(2 * node, lo, mid, cnt);
+  if (l->suf + r->pre >= cnt)
+    return mid * LEAF_SECTORS - l->suf;
+  return extent_find(2 * node + 1, mid, hi, cnt);
+}
@@ -6,6 +6,7 @@
 #include "filesys/cache.h" // added for p1: buffer cache
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 #include "threads/thread.h" // added for project 3: subdirectories
 
@@ -77,15 +78,29 @@ static block_sector_t byte_to_sector(const struct inode* inode, off_t pos) {
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+static bool resize(struct inode_disk* id, block_sector_t sector, off_t size);
+
 /* Initializes the inode module. */
 void inode_init(void) { list_init(&open_inodes); }
 
-/* Resizes a file given its inode_disk ID and a new size SIZE.
-  No change if the new size SIZE cannot be allocated. */
-bool inode_resize(struct inode_disk* id, off_t size) {
+/* Resizes a file given its inode_disk ID, stored at SECTOR, and a new size SIZE.
+  New blocks are placed near SECTOR and the file's existing data blocks.
+  No change if the new size SIZE cannot be allocated.
+  The indirect blocks and free map are updated in one journal transaction. */
+bool inode_resize(struct inode_disk* id, block_sector_t sector, off_t size) {
+  bool success;
+
+  journal_begin();
+  success = resize(id, sector, size);
+  journal_end();
+  return success;
+}
+
+/* Does the work of inode_resize() inside its transaction. */
+static bool resize(struct inode_disk* id, block_sector_t sector, off_t size) {
   ASSERT(id != NULL);
   ASSERT(size <= MAX_FILE_SIZE);
-  bool success;
+  block_sector_t goal = sector; // Allocation goal: the last block seen in file order
 
   /* Edge case: don't need to resize. */
   if (id->dbl_sect == 0 && size == 0) {
@@ -96,10 +111,11 @@ bool inode_resize(struct inode_disk* id, off_t size) {
   // Allocate doubly indirect block if it has not been allocated.
   block_sector_t dbl_block[128];
   if (id->dbl_sect == 0) {
-    if (!free_map_allocate(1, &id->dbl_sect)) {
+    if (!free_map_allocate(goal, 1, &id->dbl_sect)) {
       return false;
     }
   }
+  goal = id->dbl_sect;
   // Get the doubly indirect block.
   cache_read(id->dbl_sect, dbl_block);
 
@@ -109,8 +125,8 @@ bool inode_resize(struct inode_disk* id, off_t size) {
     off_t indir_block_base = i * 128 * BLOCK_SECTOR_SIZE;
     // Grow: allocate new indirect block if needed
     if (size > indir_block_base && indir_sect == 0) {
-      if (!free_map_allocate(1, &indir_sect)) {
-        inode_resize(id, id->length);
+      if (!free_map_allocate(goal, 1, &indir_sect)) {
+        resize(id, sector, id->length);
         return false;
       }
       dbl_block[i] = indir_sect;
@@ -130,12 +146,14 @@ bool inode_resize(struct inode_disk* id, off_t size) {
         } else if (size > (indir_block_base + j * BLOCK_SECTOR_SIZE) && indir_block[j] == 0) {
           // Grow: allocate direct block if needed
           block_sector_t dir_sect = indir_block[j];
-          if (!free_map_allocate(1, &dir_sect)) {
-            inode_resize(id, id->length);
+          if (!free_map_allocate(goal, 1, &dir_sect)) {
+            resize(id, sector, id->length);
             return false;
           }
           indir_block[j] = dir_sect;
         }
+        if (indir_block[j] != 0)
+          goal = indir_block[j];
       }
       // Shrink: release indirect block if needed.
       if (size <= indir_block_base && indir_sect != 0) {
@@ -146,10 +164,10 @@ bool inode_resize(struct inode_disk* id, off_t size) {
         free_map_release(dbl_block[i], 1);
         dbl_block[i] = 0;
       }
-      cache_write(indir_sect, indir_block);
+      journal_write(indir_sect, indir_block);
     }
   }
-  cache_write(id->dbl_sect, dbl_block);
+  journal_write(id->dbl_sect, dbl_block);
   id->length = size;
   return true;
 }
@@ -179,21 +197,23 @@ bool inode_create(block_sector_t sector, off_t length, bool directory) {
     /* Allocate pointers for this disk inode. */
     if (sector == FREE_MAP_SECTOR) {
       /* If it's the free map sector, set inode_disk, dbl_sect. */
-      if (free_map_allocate(1, &disk_inode->dbl_sect)) {
-        cache_write(sector, disk_inode);
+      if (free_map_allocate(sector, 1, &disk_inode->dbl_sect)) {
+        journal_write(sector, disk_inode);
         static char zeros[BLOCK_SECTOR_SIZE];
-        cache_write(disk_inode->dbl_sect, zeros);
+        journal_write(disk_inode->dbl_sect, zeros);
         success = true;
       }
     } else if (length == 0) {
       /* If the length is 0, don't allocate any pointers and write the disk inode. */
-      cache_write(sector, disk_inode);
+      journal_write(sector, disk_inode);
       success = true;
     } else if (length != 0) {
       /* If the length is not 0, allocate pointers accordingly. */
       static char zeros[BLOCK_SECTOR_SIZE];
-      if (free_map_allocate(1, &disk_inode->dbl_sect)) { // set dbl_sect
-        block_sector_t dbl_block[128];                   // create dbl_block
+      block_sector_t goal = sector; // Place each new block right after the previous one
+      if (free_map_allocate(goal, 1, &disk_inode->dbl_sect)) { // set dbl_sect
+        goal = disk_inode->dbl_sect;
+        block_sector_t dbl_block[128]; // create dbl_block
         memset(dbl_block, 0, BLOCK_SECTOR_SIZE);
         /* Populate double block. */
         bool outer_success = true;
@@ -205,25 +225,27 @@ bool inode_create(block_sector_t sector, off_t length, bool directory) {
           }
           off_t indir_block_base = i * 128 * BLOCK_SECTOR_SIZE;
           if (indir_block_base < length) {
-            if (!free_map_allocate(1, &dbl_block[i])) { // set indirect sect
+            if (!free_map_allocate(goal, 1, &dbl_block[i])) { // set indirect sect
               outer_success = false;
               break;
             }
+            goal = dbl_block[i];
             block_sector_t indir_block[128]; // create indirect block
             memset(indir_block, 0, BLOCK_SECTOR_SIZE);
             /* Populate indirect block. */
             for (int j = 0; j < 128; j++) {
               if (indir_block_base + j * BLOCK_SECTOR_SIZE < length) {
-                if (!free_map_allocate(1, &indir_block[j])) {
+                if (!free_map_allocate(goal, 1, &indir_block[j])) {
                   inner_success = false;
                   break;
                 }
+                goal = indir_block[j];
                 cache_write(indir_block[j], zeros); // write out zeroed-out data block
               } else {
                 break;
               }
             }
-            cache_write(dbl_block[i], indir_block); // write out indirect block
+            journal_write(dbl_block[i], indir_block); // write out indirect block
           } else {
             break;
           }
@@ -243,9 +265,9 @@ bool inode_create(block_sector_t sector, off_t length, bool directory) {
           }
           free_map_release(disk_inode->dbl_sect, 1);
         } else {
-          cache_write(disk_inode->dbl_sect, dbl_block); // write out doubly block
+          journal_write(disk_inode->dbl_sect, dbl_block); // write out doubly block
           disk_inode->length = length;
-          cache_write(sector, disk_inode); // write out disk inode
+          journal_write(sector, disk_inode); // write out disk inode
           success = true;
         }
       }
@@ -313,8 +335,10 @@ void inode_close(struct inode* inode) {
 
     /* Deallocate blocks if removed. */
     if (inode->removed) {
+      journal_begin();
       free_map_release(inode->sector, 1);
       inode_free(inode);
+      journal_end();
     }
 
     free(inode);
@@ -401,7 +425,7 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
   if (inode->sector == FREE_MAP_SECTOR) {
     block_sector_t free_map_sect = inode->data.dbl_sect;
     const void* bits = buffer_;
-    cache_write(free_map_sect, bits);
+    journal_write(free_map_sect, bits);
     return 512;
   }
 
@@ -409,18 +433,24 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
   off_t bytes_written = 0;
   uint8_t* bounce = NULL;
   struct inode_disk id;
+  /* Directory contents are metadata, so they go through the journal. */
+  void (*write_block)(block_sector_t, const void*) =
+      inode_directory(inode) ? journal_write : cache_write;
 
   cache_read(inode->sector, &id); // retrieve inode disk of this inode
 
   /* Resize if new length greater than current length. */
   if (offset + size > inode->length) {
+    journal_begin();
     // If failed to resize, return
-    if (!inode_resize(&id, offset + size)) {
+    if (!inode_resize(&id, inode->sector, offset + size)) {
+      journal_end();
       return 0;
     }
     // Otherwise, set new length and write out new inode_disk.
     inode->length = id.length;
-    cache_write(inode->sector, &id);
+    journal_write(inode->sector, &id);
+    journal_end();
   }
   inode->data = id;
 
@@ -441,7 +471,7 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
 
     if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE) {
       /* Write full sector directly to disk. */
-      cache_write(sector_idx, buffer + bytes_written);
+      write_block(sector_idx, buffer + bytes_written);
     } else {
       /* We need a bounce buffer. */
       if (bounce == NULL) {
@@ -458,7 +488,7 @@ off_t inode_write_at(struct inode* inode, const void* buffer_, off_t size, off_t
       else
         memset(bounce, 0, BLOCK_SECTOR_SIZE);
       memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
-      cache_write(sector_idx, bounce);
+      write_block(sector_idx, bounce);
     }
 
     /* Advance. */
@@ -0,0 +1,360 @@
+#include "filesys/journal.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Write-ahead metadata journal.
+
+   Inode, indirect block, directory and free map updates are
+   grouped into transactions.  A block written in a transaction
+   stays pinned in the buffer cache until the transaction
+   commits, so its home sector is never overwritten with
+   uncommitted data.  Committing writes a descriptor, an image
+   of every block in the transaction and a commit record to the
+   next free sectors of the log with a single multi-sector
+   write; the commit record's checksum tells recovery whether
+   all of it reached the disk.  Blocks then go home
+   lazily through the cache; when the log fills up, the cache is
+   flushed and the log starts over (a checkpoint).
+
+   At mount time, committed transactions still in the log are
+   replayed in order, so recovery reads at most the log, not the
+   whole disk.
+
+   A block that is freed after being logged is "revoked", so
+   that its old image is not replayed over whatever the block
+   is reused for. */
+
+/* Identifies journal sectors. */
+#define JOURNAL_MAGIC 0x4a524e4c /* Journal header. */
+#define DESC_MAGIC 0x4a444553    /* Transaction descriptor. */
+#define COMMIT_MAGIC 0x4a434d54  /* Commit record. */
+
+/* Sector numbers in a descriptor. */
+#define DESC_SLOTS 124
+
+/* Most blocks a single transaction may log.  Each one is pinned
+   in the cache, so this must stay well below the cache size. */
+#define TXN_BLOCKS 16
+
+/* First sector of the log proper. */
+#define LOG_START (JOURNAL_SECTOR + 1)
+
+/* Journal header, at JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header {
+  unsigned magic;       /* JOURNAL_MAGIC. */
+  uint32_t seq;         /* Sequence number of the transaction at the start of the log. */
+  uint32_t unused[126]; /* Not used. */
+};
+
+/* Transaction descriptor, the first sector of a transaction.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct txn_desc {
+  unsigned magic;                     /* DESC_MAGIC. */
+  uint32_t seq;                       /* Transaction sequence number. */
+  uint32_t block_cnt;                 /* Number of logged blocks that follow. */
+  uint32_t revoke_cnt;                /* Number of revoked sectors. */
+  block_sector_t sectors[DESC_SLOTS]; /* Home sectors of logged blocks, then revoked sectors. */
+};
+
+/* Commit record, the sector after a transaction's blocks.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct txn_commit {
+  unsigned magic;       /* COMMIT_MAGIC. */
+  uint32_t seq;         /* Transaction sequence number. */
+  uint32_t checksum;    /* Checksum of the logged blocks. */
+  uint32_t unused[125]; /* Not used. */
+};
+
+static struct lock journal_lock; /* Held by the thread running a transaction. */
+static int txn_depth;            /* Nesting depth of journal_begin() calls. */
+static struct txn_desc txn;      /* Running transaction. */
+static uint32_t next_seq;        /* Sequence number of the next commit. */
+static size_t log_head;          /* Offset in the log of the next commit. */
+static struct bitmap* logged;    /* Sectors logged since the last checkpoint. */
+static uint8_t* log_buf;      /* Staging area for writing one transaction. */
+static uint8_t block_buf[BLOCK_SECTOR_SIZE]; /* Scratch sector. */
+
+static void commit(void);
+static void unrevoke(block_sector_t);
+static void checkpoint(void);
+static void recover(struct journal_header*);
+static bool read_txn(size_t ofs, uint32_t seq, struct txn_desc*);
+static bool revoked_after(const struct txn_desc*, size_t txn_cnt, size_t t, block_sector_t);
+static uint32_t checksum(uint32_t, const void*);
+
+/* Initializes the journal.  If FORMAT is true, starts a new,
+   empty log; otherwise replays the transactions committed to
+   the log before the last shutdown or crash.  Panics if FORMAT
+   is false and the disk has no journal, since the sectors where
+   the log would be may then hold live data. */
+void journal_init(bool format) {
+  struct journal_header* h;
+
+  ASSERT(sizeof(struct journal_header) == BLOCK_SECTOR_SIZE);
+  ASSERT(sizeof(struct txn_desc) == BLOCK_SECTOR_SIZE);
+  ASSERT(sizeof(struct txn_commit) == BLOCK_SECTOR_SIZE);
+
+  lock_init(&journal_lock);
+  logged = bitmap_create(block_size(fs_device));
+  log_buf = malloc((TXN_BLOCKS + 2) * BLOCK_SECTOR_SIZE);
+  h = malloc(sizeof *h);
+  if (logged == NULL || log_buf == NULL || h == NULL)
+    PANIC("journal initialization failed");
+
+  block_read(fs_device, JOURNAL_SECTOR, h);
+  if (!format && h->magic != JOURNAL_MAGIC)
+    PANIC("file system has no journal; reformat it with -f");
+  if (format) {
+    /* Clear out anything a previous file system left in the log,
+       so it cannot be mistaken for our transactions. */
+    size_t i;
+    memset(h, 0, sizeof *h);
+    for (i = 0; i < JOURNAL_LOG_SECTORS; i++)
+      block_write(fs_device, LOG_START + i, h);
+    next_seq = 1;
+  } else
+    recover(h);
+
+  memset(h, 0, sizeof *h);
+  h->magic = JOURNAL_MAGIC;
+  h->seq = next_seq;
+  block_write(fs_device, JOURNAL_SECTOR, h);
+  log_head = 0;
+  free(h);
+}
+
+/* Starts a transaction, or joins the running one if the current
+   thread already has a transaction open.  Every metadata update
+   made until the matching journal_end() commits atomically. */
+void journal_begin(void) {
+  if (lock_held_by_current_thread(&journal_lock)) {
+    txn_depth++;
+    return;
+  }
+  lock_acquire(&journal_lock);
+  txn_depth = 1;
+  txn.block_cnt = txn.revoke_cnt = 0;
+}
+
+/* Ends the transaction started by the matching journal_begin(),
+   committing it if this was the outermost one. */
+void journal_end(void) {
+  ASSERT(lock_held_by_current_thread(&journal_lock));
+  if (--txn_depth == 0) {
+    commit();
+    lock_release(&journal_lock);
+  }
+}
+
+/* Writes metadata block BUF to SECTOR as part of the running
+   transaction.  Outside a transaction, the write is committed
+   on its own. */
+void journal_write(block_sector_t sector, const void* buf) {
+  size_t i;
+
+  journal_begin();
+  for (i = 0; i < txn.block_cnt; i++)
+    if (txn.sectors[i] == sector)
+      break;
+
+  if (i < txn.block_cnt) {
+    unrevoke(sector);
+    cache_write(sector, buf);
+  } else {
+    /* Transactions too large for the log go out in pieces. */
+    if (txn.block_cnt == TXN_BLOCKS || txn.block_cnt + txn.revoke_cnt == DESC_SLOTS)
+      commit();
+    unrevoke(sector);
+
+    /* Logged blocks come before revoked sectors. */
+    txn.sectors[txn.block_cnt + txn.revoke_cnt] = txn.sectors[txn.block_cnt];
+    txn.sectors[txn.block_cnt++] = sector;
+    bitmap_mark(logged, sector);
+    cache_write_pinned(sector, buf);
+  }
+  journal_end();
+}
+
+/* Drops SECTOR from the running transaction's revoked sectors,
+   because it is being logged again.  Recovery skips images
+   revoked by the same transaction that logs them, so a revoke
+   left behind would discard the new image. */
+static void unrevoke(block_sector_t sector) {
+  block_sector_t* revoked = txn.sectors + txn.block_cnt;
+  size_t i = 0;
+
+  while (i < txn.revoke_cnt)
+    if (revoked[i] == sector)
+      revoked[i] = revoked[--txn.revoke_cnt];
+    else
+      i++;
+}
+
+/* Records that the CNT sectors starting at SECTOR were freed, so
+   that recovery does not replay logged images of them over data
+   they may be reused for. */
+void journal_revoke(block_sector_t sector, size_t cnt) {
+  journal_begin();
+  for (; cnt > 0; sector++, cnt--) {
+    if (!bitmap_test(logged, sector))
+      continue;
+    if (txn.block_cnt + txn.revoke_cnt == DESC_SLOTS)
+      commit();
+    txn.sectors[txn.block_cnt + txn.revoke_cnt++] = sector;
+  }
+  journal_end();
+}
+
+/* Commits any running transaction and writes every cached block
+   home, leaving an empty log.  Called at shutdown so that the
+   next boot has nothing to replay. */
+void journal_checkpoint(void) {
+  journal_begin();
+  ASSERT(txn_depth == 1);
+  commit();
+  checkpoint();
+  journal_end();
+}
+
+/* Writes the running transaction to the log and releases its
+   blocks to the cache, then starts a new one.  Checkpoints if
+   the log could not hold another full transaction. */
+static void commit(void) {
+  struct txn_commit* c = (struct txn_commit*)(log_buf + (txn.block_cnt + 1) * BLOCK_SECTOR_SIZE);
+  uint32_t sum = 0;
+  size_t i;
+
+  if (txn.block_cnt == 0 && txn.revoke_cnt == 0)
+    return;
+
+  txn.magic = DESC_MAGIC;
+  txn.seq = next_seq;
+  memcpy(log_buf, &txn, BLOCK_SECTOR_SIZE);
+  for (i = 0; i < txn.block_cnt; i++) {
+    uint8_t* image = log_buf + (i + 1) * BLOCK_SECTOR_SIZE;
+    cache_read(txn.sectors[i], image);
+    sum = checksum(sum, image);
+  }
+
+  memset(c, 0, sizeof *c);
+  c->magic = COMMIT_MAGIC;
+  c->seq = next_seq;
+  c->checksum = sum;
+  block_write_multiple(fs_device, LOG_START + log_head, txn.block_cnt + 2, log_buf);
+
+  /* The transaction is durable, so its blocks may go home. */
+  for (i = 0; i < txn.block_cnt; i++)
+    cache_unpin(txn.sectors[i]);
+
+  log_head += txn.block_cnt + 2;
+  next_seq++;
+  txn.block_cnt = txn.revoke_cnt = 0;
+  if (log_head + TXN_BLOCKS + 2 > JOURNAL_LOG_SECTORS)
+    checkpoint();
+}
+
+/* Writes every committed block home and empties the log.  No
+   blocks may be pinned by an uncommitted transaction. */
+static void checkpoint(void) {
+  struct journal_header* h = (struct journal_header*)block_buf;
+
+  ASSERT(txn.block_cnt == 0);
+
+  cache_flush();
+  memset(h, 0, sizeof *h);
+  h->magic = JOURNAL_MAGIC;
+  h->seq = next_seq;
+  block_write(fs_device, JOURNAL_SECTOR, h);
+  log_head = 0;
+  bitmap_set_all(logged, false);
+}
+
+/* Replays every transaction committed to the log described by
+   header H, skipping block images revoked by the same or a
+   later transaction, and sets next_seq past the last one. */
+static void recover(struct journal_header* h) {
+  size_t max_txns = JOURNAL_LOG_SECTORS / 2;
+  struct txn_desc* descs = malloc(max_txns * sizeof *descs);
+  size_t txn_cnt = 0;
+  size_t ofs = 0;
+  size_t t, i;
+
+  if (descs == NULL)
+    PANIC("journal recovery failed");
+
+  /* Find the committed transactions. */
+  next_seq = h->seq;
+  while (txn_cnt < max_txns && read_txn(ofs, next_seq, &descs[txn_cnt])) {
+    ofs += descs[txn_cnt].block_cnt + 2;
+    txn_cnt++;
+    next_seq++;
+  }
+
+  /* Replay them in order. */
+  ofs = 0;
+  for (t = 0; t < txn_cnt; t++) {
+    for (i = 0; i < descs[t].block_cnt; i++) {
+      block_sector_t sector = descs[t].sectors[i];
+      if (revoked_after(descs, txn_cnt, t, sector))
+        continue;
+      block_read(fs_device, LOG_START + ofs + 1 + i, block_buf);
+      block_write(fs_device, sector, block_buf);
+    }
+    ofs += descs[t].block_cnt + 2;
+  }
+  free(descs);
+}
+
+/* Reads the transaction at offset OFS in the log into D.
+   Returns true if it has sequence number SEQ and was completely
+   committed, false otherwise. */
+static bool read_txn(size_t ofs, uint32_t seq, struct txn_desc* d) {
+  struct txn_commit* c = (struct txn_commit*)block_buf;
+  uint32_t sum = 0;
+  size_t i;
+
+  if (ofs + 2 > JOURNAL_LOG_SECTORS)
+    return false;
+  block_read(fs_device, LOG_START + ofs, d);
+  if (d->magic != DESC_MAGIC || d->seq != seq || d->block_cnt > TXN_BLOCKS ||
+      d->block_cnt + d->revoke_cnt > DESC_SLOTS || ofs + d->block_cnt + 2 > JOURNAL_LOG_SECTORS)
+    return false;
+
+  for (i = 0; i < d->block_cnt; i++) {
+    block_read(fs_device, LOG_START + ofs + 1 + i, block_buf);
+    sum = checksum(sum, block_buf);
+  }
+  block_read(fs_device, LOG_START + ofs + 1 + d->block_cnt, c);
+  return c->magic == COMMIT_MAGIC && c->seq == seq && c->checksum == sum;
+}
+
+/* Returns true if SECTOR is revoked by transaction T or a later
+   one among the TXN_CNT transactions in DESCS. */
+static bool revoked_after(const struct txn_desc* descs, size_t txn_cnt, size_t t,
+                          block_sector_t sector) {
+  size_t i;
+
+  for (; t < txn_cnt; t++)
+    for (i = 0; i < descs[t].revoke_cnt; i++)
+      if (descs[t].sectors[descs[t].block_cnt + i] == sector)
+        return true;
+  return false;
+}
+
+/* Adds the sector of data in BLOCK to checksum SUM and returns
+   the result. */
+static uint32_t checksum(uint32_t sum, const void* block) {
+  const uint32_t* words = block;
+  size_t i;
+
+  for (i = 0; i < BLOCK_SECTOR_SIZE / sizeof *words; i++)
+    sum = (sum << 5) + sum + words[i];
+  return sum;
+}
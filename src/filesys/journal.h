@@ -0,0 +1,20 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Size of the on-disk journal: a header sector followed by the
+   log itself.  The journal starts at JOURNAL_SECTOR. */
+#define JOURNAL_LOG_SECTORS 64
+#define JOURNAL_SECTORS (1 + JOURNAL_LOG_SECTORS)
+
+void journal_init(bool format);
+void journal_begin(void);
+void journal_end(void);
+void journal_write(block_sector_t, const void*);
+void journal_revoke(block_sector_t, size_t);
+void journal_checkpoint(void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,16 @@
+#ifndef __LIB_BLKTRACE_H
+#define __LIB_BLKTRACE_H
+
+#include <stdint.h>
+
+/* A completed block device request, as recorded by the kernel's
+   block trace and read back with the blktrace system call. */
+struct blktrace_entry {
+  char device[16];  /* Device name, e.g. "hda". */
+  uint32_t sector;  /* First sector on DEVICE. */
+  uint32_t cnt;     /* Number of sectors. */
+  uint32_t write;   /* 1 for a write, 0 for a read. */
+  uint64_t latency; /* CPU cycles from submission to completion. */
+};
+
+#endif /* lib/blktrace.h */
@@ -50,6 +50,67 @@ static inline elem_type last_mask(const struct bitmap* b) {
   return last_bits ? ((elem_type)1 << last_bits) - 1 : (elem_type)-1;
 }
 
+/* Returns an elem_type with the bits corresponding to bitmap bits
+   START through END, exclusive, turned on.  START and END must
+   fall within the same element, except that END may be the
+   first bit of the following element. */
+static inline elem_type range_mask(size_t start, size_t end) {
+  elem_type high = end % ELEM_BITS ? bit_mask(end) - 1 : (elem_type)-1;
+  return high & ~(bit_mask(start) - 1);
+}
+
+/* Returns the number of 1-bits in E.
+   GCC turns __builtin_popcount() into a call to libgcc's
+   __popcountsi2() unless the POPCNT instruction is available,
+   and we link without libgcc (see lib/arithmetic.c), so this is
+   the usual branch-free SWAR reduction instead. */
+static inline size_t elem_popcount(elem_type e) {
+  e = e - ((e >> 1) & 0x55555555);
+  e = (e & 0x33333333) + ((e >> 2) & 0x33333333);
+  e = (e + (e >> 4)) & 0x0f0f0f0f;
+  return (e * 0x01010101) >> 24;
+}
+
+/* Returns the index of the lowest 1-bit in E, which must be
+   nonzero.  Compiles to a single BSF instruction. */
+static inline size_t elem_ffs(elem_type e) { return __builtin_ctzl(e); }
+
+/* Applies MASK to element IDX of B, turning the masked bits on
+   if VALUE is true, off otherwise.  Atomic on a uniprocessor
+   machine, like bitmap_mark() and bitmap_reset(). */
+static inline void elem_apply(struct bitmap* b, size_t idx, elem_type mask, bool value) {
+  if (value)
+    asm("orl %1, %0" : "=m"(b->bits[idx]) : "r"(mask) : "cc");
+  else
+    asm("andl %1, %0" : "=m"(b->bits[idx]) : "r"(~mask) : "cc");
+}
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's size if there is none.  Elements that
+   hold no such bit are skipped with a single comparison. */
+static size_t find_next(const struct bitmap* b, size_t start, bool value) {
+  size_t idx = elem_idx(start);
+  size_t last_idx = elem_cnt(b->bit_cnt);
+  elem_type flip = value ? 0 : (elem_type)-1;
+  elem_type e;
+  size_t bit;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  e = (b->bits[idx] ^ flip) & ~(bit_mask(start) - 1);
+  while (e == 0) {
+    if (++idx >= last_idx)
+      return b->bit_cnt;
+    e = b->bits[idx] ^ flip;
+  }
+
+  /* Bits past the end of the last element read as whatever
+     FLIP made them, so clamp. */
+  bit = idx * ELEM_BITS + elem_ffs(e);
+  return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -165,46 +226,66 @@ void bitmap_set_all(struct bitmap* b, bool value) {
   bitmap_set_multiple(b, 0, bitmap_size(b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Whole elements are written at once; each element is updated
+   atomically, but the group as a whole is not. */
 void bitmap_set_multiple(struct bitmap* b, size_t start, size_t cnt, bool value) {
-  size_t i;
+  size_t end = start + cnt;
 
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
   ASSERT(start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set(b, start + i, value);
+  while (start < end) {
+    size_t idx = elem_idx(start);
+    size_t elem_end = (idx + 1) * ELEM_BITS;
+    size_t stop = end < elem_end ? end : elem_end;
+
+    elem_apply(b, idx, range_mask(start, stop), value);
+    start = stop;
+  }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
    exclusive, that are set to VALUE. */
 size_t bitmap_count(const struct bitmap* b, size_t start, size_t cnt, bool value) {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t one_cnt = 0;
 
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
   ASSERT(start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test(b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  while (start < end) {
+    size_t idx = elem_idx(start);
+    size_t elem_end = (idx + 1) * ELEM_BITS;
+    size_t stop = end < elem_end ? end : elem_end;
+
+    one_cnt += elem_popcount(b->bits[idx] & range_mask(start, stop));
+    start = stop;
+  }
+  return value ? one_cnt : cnt - one_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
    exclusive, are set to VALUE, and false otherwise. */
 bool bitmap_contains(const struct bitmap* b, size_t start, size_t cnt, bool value) {
-  size_t i;
+  size_t end = start + cnt;
+  elem_type flip = value ? 0 : (elem_type)-1;
 
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
   ASSERT(start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test(b, start + i) == value)
+  while (start < end) {
+    size_t idx = elem_idx(start);
+    size_t elem_end = (idx + 1) * ELEM_BITS;
+    size_t stop = end < elem_end ? end : elem_end;
+
+    if ((b->bits[idx] ^ flip) & range_mask(start, stop))
       return true;
+    start = stop;
+  }
   return false;
 }
 
@@ -231,17 +312,33 @@ bool bitmap_all(const struct bitmap* b, size_t start, size_t cnt) {
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Rather than testing every candidate position, this jumps to
+   the next bit set to VALUE, then to the next bit that is not,
+   and checks whether the run between them is long enough.  Both
+   jumps skip whole elements at a time. */
 size_t bitmap_scan(const struct bitmap* b, size_t start, size_t cnt, bool value) {
   ASSERT(b != NULL);
   ASSERT(start <= b->bit_cnt);
 
   if (cnt <= b->bit_cnt) {
     size_t last = b->bit_cnt - cnt;
-    size_t i;
-    for (i = start; i <= last; i++)
-      if (!bitmap_contains(b, i, cnt, !value))
+    size_t i = start;
+
+    if (cnt == 0)
+      return start <= last ? start : BITMAP_ERROR;
+    while (i <= last) {
+      size_t run_end;
+
+      i = find_next(b, i, value);
+      if (i > last)
+        break;
+      run_end = find_next(b, i, !value);
+      if (run_end - i >= cnt)
         return i;
+      i = run_end;
+    }
   }
   return BITMAP_ERROR;
 }
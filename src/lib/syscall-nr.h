@@ -46,7 +46,19 @@ enum {
   SYS_MKDIR,   /* Create a directory. */
   SYS_READDIR, /* Reads a directory entry. */
   SYS_ISDIR,   /* Tests if a fd represents a directory. */
-  SYS_INUMBER  /* Returns the inode number for a fd. */
+  SYS_INUMBER, /* Returns the inode number for a fd. */
+
+  /* Durable writes. */
+  SYS_FSYNC, /* Writes a file's data to disk. */
+
+  /* Block device tracing. */
+  SYS_BLKTRACE, /* Reads the block request trace. */
+
+  /* High-resolution time. */
+  SYS_CLOCK_NS, /* Gets nanoseconds since timer calibration. */
+
+  /* CPU accounting. */
+  SYS_THREADSTAT /* Reads per-thread CPU accounting. */
 };
 
 #endif /* lib/syscall-nr.h */
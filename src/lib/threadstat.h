@@ -0,0 +1,27 @@
+#ifndef __LIB_THREADSTAT_H
+#define __LIB_THREADSTAT_H
+
+#include <stdint.h>
+
+/* Thread states as reported in struct threadstat. */
+#define THREADSTAT_RUNNING 'R' /* Running. */
+#define THREADSTAT_READY 'r'   /* In a ready queue. */
+#define THREADSTAT_BLOCKED 'B' /* Waiting for an event. */
+
+/* CPU accounting for one thread, as read back with the
+   threadstat system call. */
+struct threadstat {
+  int tid;                /* Thread identifier. */
+  int pid;                /* Process identifier, or 0 for a kernel thread. */
+  char name[16];          /* Thread name. */
+  int priority;           /* Current priority. */
+  char state;             /* One of the THREADSTAT_* states. */
+  uint64_t run_ticks;     /* Timer ticks spent running. */
+  uint32_t voluntary;     /* Context switches from blocking or yielding. */
+  uint32_t involuntary;   /* Context switches from preemption. */
+  uint32_t wait_cnt;      /* Number of times scheduled from a ready queue. */
+  uint64_t wait_total_ns; /* Total time spent in ready queues. */
+  uint64_t wait_max_ns;   /* Longest single time spent in a ready queue. */
+};
+
+#endif /* lib/threadstat.h */
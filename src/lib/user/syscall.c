@@ -116,6 +116,18 @@ bool isdir(int fd) { return syscall1(SYS_ISDIR, fd); }
 
 int inumber(int fd) { return syscall1(SYS_INUMBER, fd); }
 
+bool fsync(int fd) { return syscall1(SYS_FSYNC, fd); }
+
+int blktrace(struct blktrace_entry* buf, int max) { return syscall2(SYS_BLKTRACE, buf, max); }
+
+uint64_t clock_ns(void) {
+  uint64_t ns;
+  syscall1(SYS_CLOCK_NS, &ns);
+  return ns;
+}
+
+int threadstat(struct threadstat* buf, int max) { return syscall2(SYS_THREADSTAT, buf, max); }
+
 double compute_e(int n) { return (double)syscall1f(SYS_COMPUTE_E, n); }
 
 tid_t sys_pthread_create(stub_fun sfun, pthread_fun tfun, const void* arg) {
@@ -2,6 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <blktrace.h>
+#include <threadstat.h>
 #include <debug.h>
 #include <pthread.h>
 
@@ -70,4 +73,15 @@ bool readdir(int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir(int fd);
 int inumber(int fd);
 
+/* Durable writes. */
+bool fsync(int fd);
+
+/* Block device tracing. */
+int blktrace(struct blktrace_entry* buf, int max);
+
+/* High-resolution time: nanoseconds since the kernel calibrated
+   its clock, early in boot.  Only differences are meaningful. */
+uint64_t clock_ns(void);
+int threadstat(struct threadstat* buf, int max);
+
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,41 @@
+/* Child process for syn-fsync test.
+   Writes into part of a test file, calling fsync() after every
+   write, and does so ROUND_CNT times over.  Other processes will
+   be doing the same with other parts at the same time. */
+
+#include <random.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/syn-fsync.h"
+
+char buf[BUF_SIZE];
+
+int main(int argc, char* argv[]) {
+  int child_idx;
+  int fd;
+  int round;
+  int ofs;
+
+  quiet = true;
+
+  CHECK(argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi(argv[1]);
+
+  random_init(0);
+  random_bytes(buf, sizeof buf);
+
+  CHECK((fd = open(file_name)) > 1, "open \"%s\"", file_name);
+  for (round = 0; round < ROUND_CNT; round++) {
+    seek(fd, CHUNK_SIZE * child_idx);
+    for (ofs = 0; ofs < CHUNK_SIZE; ofs += WRITE_SIZE) {
+      CHECK(write(fd, buf + CHUNK_SIZE * child_idx + ofs, WRITE_SIZE) > 0, "write \"%s\"",
+            file_name);
+      CHECK(fsync(fd), "fsync \"%s\"", file_name);
+    }
+  }
+  msg("close \"%s\"", file_name);
+  close(fd);
+
+  return child_idx;
+}
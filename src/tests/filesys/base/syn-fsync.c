@@ -0,0 +1,54 @@
+/* Spawns 1, 2, 4, and then 10 child processes that write out
+   different parts of the contents of a file, forcing each piece
+   to disk with fsync() as they go, and waits for them to finish.
+   Reports how many fsync() calls per second each group of
+   writers completed, which group commit should raise as writers
+   are added.  Then reads back the file and verifies its
+   contents. */
+
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/base/syn-fsync.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+char buf1[BUF_SIZE];
+char buf2[BUF_SIZE];
+
+static void run_writers(size_t writer_cnt);
+
+void test_main(void) {
+  int fd;
+
+  CHECK(create(file_name, sizeof buf1), "create \"%s\"", file_name);
+
+  run_writers(1);
+  run_writers(2);
+  run_writers(4);
+  run_writers(CHILD_CNT);
+
+  CHECK((fd = open(file_name)) > 1, "open \"%s\"", file_name);
+  CHECK(read(fd, buf1, sizeof buf1) > 0, "read \"%s\"", file_name);
+  random_bytes(buf2, sizeof buf2);
+  compare_bytes(buf1, buf2, sizeof buf1, 0, file_name);
+}
+
+/* Runs WRITER_CNT children at once, each writing its own part of
+   the file, and reports their combined rate of fsync() calls. */
+static void run_writers(size_t writer_cnt) {
+  pid_t children[CHILD_CNT];
+  uint64_t start, elapsed_us;
+  unsigned fsync_cnt = writer_cnt * FSYNC_CNT;
+
+  start = clock_ns();
+  exec_children("child-fsync", children, writer_cnt);
+  wait_children(children, writer_cnt);
+  elapsed_us = (clock_ns() - start) / 1000;
+  if (elapsed_us == 0)
+    elapsed_us = 1;
+
+  msg("%zu writer%s: %u fsyncs in %llu us, %llu fsyncs per second", writer_cnt,
+      writer_cnt == 1 ? "" : "s", fsync_cnt, elapsed_us, fsync_cnt * 1000000ULL / elapsed_us);
+}
@@ -0,0 +1,49 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(syn-fsync\) begin$/,
+	      qr/^\(syn-fsync\) create "stuff"$/,
+	      qr/^\(syn-fsync\) exec child 1 of 1: "child-fsync 0"$/,
+	      qr/^\(syn-fsync\) wait for child 1 of 1 returned 0 \(expected 0\)$/,
+	      qr/^\(syn-fsync\) 1 writer: 32 fsyncs in \d+ us, \d+ fsyncs per second$/,
+	      qr/^\(syn-fsync\) exec child 1 of 2: "child-fsync 0"$/,
+	      qr/^\(syn-fsync\) exec child 2 of 2: "child-fsync 1"$/,
+	      qr/^\(syn-fsync\) wait for child 1 of 2 returned 0 \(expected 0\)$/,
+	      qr/^\(syn-fsync\) wait for child 2 of 2 returned 1 \(expected 1\)$/,
+	      qr/^\(syn-fsync\) 2 writers: 64 fsyncs in \d+ us, \d+ fsyncs per second$/,
+	      qr/^\(syn-fsync\) exec child 1 of 4: "child-fsync 0"$/,
+	      qr/^\(syn-fsync\) exec child 2 of 4: "child-fsync 1"$/,
+	      qr/^\(syn-fsync\) exec child 3 of 4: "child-fsync 2"$/,
+	      qr/^\(syn-fsync\) exec child 4 of 4: "child-fsync 3"$/,
+	      qr/^\(syn-fsync\) wait for child 1 of 4 returned 0 \(expected 0\)$/,
+	      qr/^\(syn-fsync\) wait for child 2 of 4 returned 1 \(expected 1\)$/,
+	      qr/^\(syn-fsync\) wait for child 3 of 4 returned 2 \(expected 2\)$/,
+	      qr/^\(syn-fsync\) wait for child 4 of 4 returned 3 \(expected 3\)$/,
+	      qr/^\(syn-fsync\) 4 writers: 128 fsyncs in \d+ us, \d+ fsyncs per second$/,
+	      qr/^\(syn-fsync\) exec child 1 of 10: "child-fsync 0"$/,
+	      qr/^\(syn-fsync\) exec child 2 of 10: "child-fsync 1"$/,
+	      qr/^\(syn-fsync\) exec child 3 of 10: "child-fsync 2"$/,
+	      qr/^\(syn-fsync\) exec child 4 of 10: "child-fsync 3"$/,
+	      qr/^\(syn-fsync\) exec child 5 of 10: "child-fsync 4"$/,
+	      qr/^\(syn-fsync\) exec child 6 of 10: "child-fsync 5"$/,
+	      qr/^\(syn-fsync\) exec child 7 of 10: "child-fsync 6"$/,
+	      qr/^\(syn-fsync\) exec child 8 of 10: "child-fsync 7"$/,
+	      qr/^\(syn-fsync\) exec child 9 of 10: "child-fsync 8"$/,
+	      qr/^\(syn-fsync\) exec child 10 of 10: "child-fsync 9"$/,
+	      qr/^\(syn-fsync\) wait for child 1 of 10 returned 0 \(expected 0\)$/,
+	      qr/^\(syn-fsync\) wait for child 2 of 10 returned 1 \(expected 1\)$/,
+	      qr/^\(syn-fsync\) wait for child 3 of 10 returned 2 \(expected 2\)$/,
+	      qr/^\(syn-fsync\) wait for child 4 of 10 returned 3 \(expected 3\)$/,
+	      qr/^\(syn-fsync\) wait for child 5 of 10 returned 4 \(expected 4\)$/,
+	      qr/^\(syn-fsync\) wait for child 6 of 10 returned 5 \(expected 5\)$/,
+	      qr/^\(syn-fsync\) wait for child 7 of 10 returned 6 \(expected 6\)$/,
+	      qr/^\(syn-fsync\) wait for child 8 of 10 returned 7 \(expected 7\)$/,
+	      qr/^\(syn-fsync\) wait for child 9 of 10 returned 8 \(expected 8\)$/,
+	      qr/^\(syn-fsync\) wait for child 10 of 10 returned 9 \(expected 9\)$/,
+	      qr/^\(syn-fsync\) 10 writers: 320 fsyncs in \d+ us, \d+ fsyncs per second$/,
+	      qr/^\(syn-fsync\) open "stuff"$/,
+	      qr/^\(syn-fsync\) read "stuff"$/,
+	      qr/^\(syn-fsync\) end$/]);
@@ -0,0 +1,15 @@
+#ifndef TESTS_FILESYS_BASE_SYN_FSYNC_H
+#define TESTS_FILESYS_BASE_SYN_FSYNC_H
+
+#include "tests/filesys/base/syn-write.h"
+
+/* Number of bytes written between calls to fsync(). */
+#define WRITE_SIZE 64
+
+/* Number of times each child writes its whole chunk. */
+#define ROUND_CNT 4
+
+/* Number of calls to fsync() made by each child. */
+#define FSYNC_CNT (ROUND_CNT * (CHUNK_SIZE / WRITE_SIZE))
+
+#endif /* tests/filesys/base/syn-fsync.h */
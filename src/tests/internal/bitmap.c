@@ -0,0 +1,120 @@
+/* Test program and microbenchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan() and bitmap_count() against the original
+   bit-at-a-time algorithms on large sparse and dense bitmaps,
+   and reports how many CPU cycles each takes.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of bits in each bitmap we benchmark: enough for a
+   512 MB disk's free map. */
+#define BIT_CNT (1024 * 1024)
+
+/* Number of scans timed per bitmap. */
+#define SCAN_CNT 64
+
+static void run_bench(const char* name, int density);
+static size_t old_scan(const struct bitmap*, size_t start, size_t cnt, bool);
+static size_t old_count(const struct bitmap*, size_t start, size_t cnt, bool);
+static uint64_t rdtsc(void);
+
+/* Benchmarks bitmaps with 1%, 50%, and 99% of their bits set. */
+void test(void) {
+  run_bench("sparse", 1);
+  run_bench("half", 50);
+  run_bench("dense", 99);
+  printf("bitmap: PASS\n");
+}
+
+/* Fills a bitmap so that DENSITY percent of its bits are set,
+   then times scans for runs of 1, 8, and 64 clear bits and a
+   count over the whole bitmap with both implementations. */
+static void run_bench(const char* name, int density) {
+  static const size_t run_lengths[] = {1, 8, 64};
+  struct bitmap* b = bitmap_create(BIT_CNT);
+  uint64_t start, old_cycles, new_cycles;
+  size_t i, r;
+
+  ASSERT(b != NULL);
+  for (i = 0; i < BIT_CNT; i++)
+    if ((int)(random_ulong() % 100) < density)
+      bitmap_mark(b, i);
+
+  for (r = 0; r < sizeof run_lengths / sizeof *run_lengths; r++) {
+    size_t cnt = run_lengths[r];
+    size_t starts[SCAN_CNT];
+    size_t old_idx[SCAN_CNT];
+
+    for (i = 0; i < SCAN_CNT; i++)
+      starts[i] = random_ulong() % BIT_CNT;
+
+    start = rdtsc();
+    for (i = 0; i < SCAN_CNT; i++)
+      old_idx[i] = old_scan(b, starts[i], cnt, false);
+    old_cycles = rdtsc() - start;
+
+    start = rdtsc();
+    for (i = 0; i < SCAN_CNT; i++)
+      ASSERT(bitmap_scan(b, starts[i], cnt, false) == old_idx[i]);
+    new_cycles = rdtsc() - start;
+
+    printf("%s: scan for %zu clear bits: %" PRIu64 " cycles old, %" PRIu64 " cycles new\n", name,
+           cnt, old_cycles / SCAN_CNT, new_cycles / SCAN_CNT);
+  }
+
+  start = rdtsc();
+  r = old_count(b, 0, BIT_CNT, true);
+  old_cycles = rdtsc() - start;
+
+  start = rdtsc();
+  ASSERT(bitmap_count(b, 0, BIT_CNT, true) == r);
+  new_cycles = rdtsc() - start;
+
+  printf("%s: count of %zu set bits: %" PRIu64 " cycles old, %" PRIu64 " cycles new\n", name, r,
+         old_cycles, new_cycles);
+  bitmap_destroy(b);
+}
+
+/* The original bitmap_scan(), which tests every candidate
+   position bit by bit. */
+static size_t old_scan(const struct bitmap* b, size_t start, size_t cnt, bool value) {
+  if (cnt <= bitmap_size(b)) {
+    size_t last = bitmap_size(b) - cnt;
+    size_t i, j;
+    for (i = start; i <= last; i++) {
+      for (j = 0; j < cnt; j++)
+        if (bitmap_test(b, i + j) != value)
+          break;
+      if (j == cnt)
+        return i;
+    }
+  }
+  return BITMAP_ERROR;
+}
+
+/* The original bitmap_count(), which tests one bit at a time. */
+static size_t old_count(const struct bitmap* b, size_t start, size_t cnt, bool value) {
+  size_t i, value_cnt = 0;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test(b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t rdtsc(void) {
+  uint64_t tsc;
+  asm volatile("rdtsc" : "=A"(tsc));
+  return tsc;
+}
@@ -0,0 +1,102 @@
+/* Creates many threads, each of which sleeps several times for
+   durations that spread the sleepers across the timing wheel's
+   levels.  Verifies that no thread wakes up early and that every
+   sleep ends.
+
+   The kernel's timer statistics, printed at shutdown, report the
+   longest time the timer code kept interrupts off, which should
+   not grow with the number of sleepers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of sleeping threads. */
+#define THREAD_CNT 200
+
+/* Number of times each thread sleeps. */
+#define ITERATIONS 3
+
+/* Information about the test. */
+struct stress_test {
+  int64_t start;           /* Current time at start of test. */
+  struct semaphore done;   /* Up'd by each thread when it finishes. */
+  struct lock result_lock; /* Lock protecting the counts below. */
+  int wakeups;             /* Number of sleeps that ended. */
+  int early;               /* Number that ended too early. */
+};
+
+/* Information about an individual thread in the test. */
+struct stress_thread {
+  struct stress_test* test; /* Info shared between all threads. */
+  int id;                   /* Sleeper ID. */
+};
+
+static void sleeper(void*);
+
+void test_alarm_stress(void) {
+  struct stress_test test;
+  struct stress_thread* threads;
+  int i;
+
+  ASSERT(active_sched_policy == SCHED_FIFO);
+
+  msg("Creating %d threads to sleep %d times each.", THREAD_CNT, ITERATIONS);
+  msg("Each sleep lasts between 1 and 400 ticks.");
+  msg("If successful, no thread wakes up early.");
+
+  threads = malloc(sizeof *threads * THREAD_CNT);
+  if (threads == NULL)
+    PANIC("couldn't allocate memory for test");
+
+  test.start = timer_ticks() + 100;
+  sema_init(&test.done, 0);
+  lock_init(&test.result_lock);
+  test.wakeups = 0;
+  test.early = 0;
+
+  for (i = 0; i < THREAD_CNT; i++) {
+    struct stress_thread* t = threads + i;
+    char name[16];
+
+    t->test = &test;
+    t->id = i;
+    snprintf(name, sizeof name, "sleeper %d", i);
+    thread_create(name, PRI_DEFAULT, sleeper, t);
+  }
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down(&test.done);
+
+  if (test.wakeups != THREAD_CNT * ITERATIONS)
+    fail("%d wakeups instead of %d", test.wakeups, THREAD_CNT * ITERATIONS);
+  if (test.early > 0)
+    fail("%d of %d wakeups were early", test.early, test.wakeups);
+  msg("All %d wakeups were on time.", test.wakeups);
+
+  free(threads);
+}
+
+/* Sleeper thread. */
+static void sleeper(void* t_) {
+  struct stress_thread* t = t_;
+  struct stress_test* test = t->test;
+  int64_t wakeup = test->start;
+  int i;
+
+  for (i = 0; i < ITERATIONS; i++) {
+    wakeup += 1 + (t->id * 37 + i * 101) % 400;
+    timer_sleep(wakeup - timer_ticks());
+
+    lock_acquire(&test->result_lock);
+    test->wakeups++;
+    if (timer_ticks() < wakeup)
+      test->early++;
+    lock_release(&test->result_lock);
+  }
+  sema_up(&test->done);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-stress) begin
+(alarm-stress) Creating 200 threads to sleep 3 times each.
+(alarm-stress) Each sleep lasts between 1 and 400 ticks.
+(alarm-stress) If successful, no thread wakes up early.
+(alarm-stress) All 600 wakeups were on time.
+(alarm-stress) end
+EOF
+pass;
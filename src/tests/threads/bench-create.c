@@ -0,0 +1,44 @@
+/* Benchmarks thread creation.  The main thread creates
+   CREATE_CNT threads one after another, waiting for each to exit
+   before creating the next, so that each creation can reuse the
+   page of the thread before it.
+
+   Reports creations per second, each including the new thread's
+   first run and exit.  The numbers are for comparing kernels, so
+   only their presence is checked. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of threads to create. */
+#define CREATE_CNT 1000
+
+static thread_func exiter;
+static struct semaphore done;
+
+void test_bench_create(void) {
+  uint64_t start_cycles, cycles, ns;
+  int i;
+
+  msg("Creating %d threads, one at a time.", CREATE_CNT);
+  sema_init(&done, 0);
+  start_cycles = timer_cycles();
+  for (i = 0; i < CREATE_CNT; i++) {
+    if (thread_create("exiter", PRI_DEFAULT, exiter, NULL) == TID_ERROR)
+      fail("thread_create() failed after %d threads", i);
+    sema_down(&done);
+  }
+  cycles = timer_cycles() - start_cycles;
+  ns = timer_cycles_to_ns(cycles);
+
+  msg("Throughput: %" PRIu64 " creations per second, %" PRIu64 " cycles per creation.",
+      ns > 0 ? (uint64_t)CREATE_CNT * 1000000000 / ns : 0, cycles / CREATE_CNT);
+}
+
+/* Exits as soon as it runs. */
+static void exiter(void* aux UNUSED) { sema_up(&done); }
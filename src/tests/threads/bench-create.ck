@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(bench-create\) begin$/,
+	      qr/^\(bench-create\) Creating 1000 threads, one at a time\.$/,
+	      qr/^\(bench-create\) Throughput: \d+ creations per second, \d+ cycles per creation\.$/,
+	      qr/^\(bench-create\) end$/]);
@@ -0,0 +1,53 @@
+/* Benchmarks context switching.  The main thread and a partner
+   thread hand control back and forth through a pair of
+   semaphores ROUND_CNT times, neither touching the FPU, so each
+   round trip costs two context switches and little else.
+
+   Reports the cycles taken per context switch.  The numbers are
+   for comparing kernels, so only their presence is checked. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of round trips. */
+#define ROUND_CNT 10000
+
+static thread_func pong;
+static struct semaphore ping_sema, pong_sema, done;
+
+void test_bench_pingpong(void) {
+  uint64_t start_cycles, cycles;
+  int i;
+
+  msg("Passing control back and forth %d times.", ROUND_CNT);
+  sema_init(&ping_sema, 0);
+  sema_init(&pong_sema, 0);
+  sema_init(&done, 0);
+  thread_create("pong", PRI_DEFAULT, pong, NULL);
+
+  start_cycles = timer_cycles();
+  for (i = 0; i < ROUND_CNT; i++) {
+    sema_up(&ping_sema);
+    sema_down(&pong_sema);
+  }
+  cycles = timer_cycles() - start_cycles;
+  sema_down(&done);
+
+  msg("Context switch: %" PRIu64 " cycles.", cycles / (2 * ROUND_CNT));
+}
+
+/* Answers each of the main thread's pings. */
+static void pong(void* aux UNUSED) {
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) {
+    sema_down(&ping_sema);
+    sema_up(&pong_sema);
+  }
+  sema_up(&done);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(bench-pingpong\) begin$/,
+	      qr/^\(bench-pingpong\) Passing control back and forth 10000 times\.$/,
+	      qr/^\(bench-pingpong\) Context switch: \d+ cycles\.$/,
+	      qr/^\(bench-pingpong\) end$/]);
@@ -0,0 +1,50 @@
+/* Benchmarks wakeup latency.  The main thread calls
+   timer_sleep(1) SLEEP_CNT times with nothing else to run.
+   Before each sleep it waits for a tick to begin, so that it
+   should wake exactly one tick period later, and it records that
+   target time.  On waking it reads timer_ns() and takes the
+   difference, which covers the timer interrupt, the wakeup, and
+   the switch back to the thread.
+
+   Reports the average and worst latency in nanoseconds.  The
+   numbers are for comparing kernels, so only their presence is
+   checked. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of sleeps. */
+#define SLEEP_CNT 100
+
+/* Nanoseconds per timer tick. */
+#define TICK_NS (1000000000 / TIMER_FREQ)
+
+void test_bench_sleep(void) {
+  uint64_t total = 0, worst = 0;
+  int i;
+
+  msg("Sleeping for 1 tick %d times.", SLEEP_CNT);
+  for (i = 0; i < SLEEP_CNT; i++) {
+    int64_t tick = timer_ticks();
+    uint64_t target, now, latency;
+
+    while (timer_ticks() == tick)
+      continue;
+    target = timer_ns() + TICK_NS;
+    timer_sleep(1);
+    now = timer_ns();
+
+    /* The tick period is measured with a different clock, so an
+       early wakeup by a hair counts as no latency. */
+    latency = now > target ? now - target : 0;
+    total += latency;
+    if (latency > worst)
+      worst = latency;
+  }
+
+  msg("Wakeup latency: %" PRIu64 " ns average, %" PRIu64 " ns worst.", total / SLEEP_CNT, worst);
+}
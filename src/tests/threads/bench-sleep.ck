@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(bench-sleep\) begin$/,
+	      qr/^\(bench-sleep\) Sleeping for 1 tick 100 times\.$/,
+	      qr/^\(bench-sleep\) Wakeup latency: \d+ ns average, \d+ ns worst\.$/,
+	      qr/^\(bench-sleep\) end$/]);
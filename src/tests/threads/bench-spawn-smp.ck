@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(bench-spawn-smp\) begin$/,
+	      qr/^\(bench-spawn-smp\) Running 1000 threads, 8 at a time\.$/,
+	      qr/^\(bench-spawn-smp\) Throughput: \d+ threads per second, \d+ cycles per thread\.$/,
+	      qr/^\(bench-spawn-smp\) Migrations: [1-9]\d*\.$/,
+	      qr/^\(bench-spawn-smp\) end$/]);
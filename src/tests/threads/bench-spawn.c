@@ -0,0 +1,64 @@
+/* Benchmarks the scheduler with many short-lived threads.  The
+   main thread keeps BATCH threads alive at a time, each of which
+   does a little work and exits, until SPAWN_CNT have run.
+
+   Reports the number of threads created, run, and reaped per
+   second, and how many times a ready thread was moved from one
+   CPU's ready queue to another's.  The numbers are for comparing
+   kernels, so only their presence is checked, except that
+   bench-spawn-smp, which runs on several CPUs, must see threads
+   migrate. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Total number of threads to run. */
+#define SPAWN_CNT 1000
+
+/* Number of threads alive at once. */
+#define BATCH 8
+
+/* Iterations of busy work per thread. */
+#define WORK 1000
+
+static thread_func worker;
+static struct semaphore slots;
+
+void test_bench_spawn(void) {
+  uint64_t start_cycles, cycles, ns;
+  uint64_t start_migrations;
+  int i;
+
+  msg("Running %d threads, %d at a time.", SPAWN_CNT, BATCH);
+  sema_init(&slots, BATCH);
+  start_migrations = thread_migration_cnt();
+  start_cycles = timer_cycles();
+  for (i = 0; i < SPAWN_CNT; i++) {
+    sema_down(&slots);
+    if (thread_create("worker", PRI_DEFAULT, worker, NULL) == TID_ERROR)
+      fail("thread_create() failed after %d threads", i);
+  }
+  for (i = 0; i < BATCH; i++)
+    sema_down(&slots);
+  cycles = timer_cycles() - start_cycles;
+  ns = timer_cycles_to_ns(cycles);
+
+  msg("Throughput: %" PRIu64 " threads per second, %" PRIu64 " cycles per thread.",
+      ns > 0 ? (uint64_t)SPAWN_CNT * 1000000000 / ns : 0, cycles / SPAWN_CNT);
+  msg("Migrations: %" PRIu64 ".", thread_migration_cnt() - start_migrations);
+}
+
+/* Does a little work, then frees a slot for the next thread. */
+static void worker(void* aux UNUSED) {
+  volatile int x = 0;
+  int i;
+
+  for (i = 0; i < WORK; i++)
+    x += i;
+  sema_up(&slots);
+}
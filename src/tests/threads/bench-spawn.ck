@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(bench-spawn\) begin$/,
+	      qr/^\(bench-spawn\) Running 1000 threads, 8 at a time\.$/,
+	      qr/^\(bench-spawn\) Throughput: \d+ threads per second, \d+ cycles per thread\.$/,
+	      qr/^\(bench-spawn\) Migrations: \d+\.$/,
+	      qr/^\(bench-spawn\) end$/]);
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(bench-yield-2\) begin$/,
+	      qr/^\(bench-yield-2\) 2 threads yielding 1000 times each\.$/,
+	      qr/^\(bench-yield-2\) Yield: \d+ cycles\.$/,
+	      qr/^\(bench-yield-2\) end$/]);
@@ -0,0 +1,59 @@
+/* Benchmarks thread_yield().  N threads each yield YIELD_CNT
+   times while the main thread waits, so the CPU does nothing
+   but pass from one ready thread to the next.
+
+   Reports the cycles taken per yield.  The numbers are for
+   comparing kernels, so only their presence is checked. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of times each thread yields. */
+#define YIELD_CNT 1000
+
+static void yield_storm(int thread_cnt);
+static thread_func yielder;
+static struct semaphore start, done;
+
+void test_bench_yield_2(void) { yield_storm(2); }
+
+void test_bench_yield_16(void) { yield_storm(16); }
+
+/* Runs THREAD_CNT threads that do nothing but yield. */
+static void yield_storm(int thread_cnt) {
+  uint64_t start_cycles, cycles;
+  int i;
+
+  msg("%d threads yielding %d times each.", thread_cnt, YIELD_CNT);
+  sema_init(&start, 0);
+  sema_init(&done, 0);
+  for (i = 0; i < thread_cnt; i++)
+    if (thread_create("yielder", PRI_DEFAULT, yielder, NULL) == TID_ERROR)
+      fail("thread_create() failed");
+
+  /* Release the threads together, so that the time taken to
+     create them is not counted. */
+  start_cycles = timer_cycles();
+  for (i = 0; i < thread_cnt; i++)
+    sema_up(&start);
+  for (i = 0; i < thread_cnt; i++)
+    sema_down(&done);
+  cycles = timer_cycles() - start_cycles;
+
+  msg("Yield: %" PRIu64 " cycles.", cycles / ((uint64_t)thread_cnt * YIELD_CNT));
+}
+
+/* Waits to be started, then yields YIELD_CNT times. */
+static void yielder(void* aux UNUSED) {
+  int i;
+
+  sema_down(&start);
+  for (i = 0; i < YIELD_CNT; i++)
+    thread_yield();
+  sema_up(&done);
+}
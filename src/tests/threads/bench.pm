@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+
+# Checks the output of a benchmark, whose numbers change from run
+# to run.  Each element of @$patterns is a regular expression
+# that must match one line of the test's core output, in order.
+sub check_bench {
+    my ($patterns) = @_;
+    our ($test);
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    @output = get_core_output ("run", @output);
+
+    my ($i) = 0;
+    foreach my $pattern (@$patterns) {
+	$i++ while $i < @output && $output[$i] !~ /$pattern/;
+	fail "Benchmark output has no line matching $pattern\n"
+	  if $i >= @output;
+	$i++;
+    }
+    pass;
+}
+
+1;
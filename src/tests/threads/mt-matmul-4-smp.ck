@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::bench;
+
+check_bench ([qr/^\(mt-matmul-4-smp\) begin$/,
+	      qr/^\(mt-matmul-4-smp\) Executing single-threaded matmul\.\.\.$/,
+	      qr/^\(mt-matmul-4-smp\) Matrix results match expected values\.$/,
+	      qr/^\(mt-matmul-4-smp\) Executing blocked matmul with 4 threads on 4 CPUs\.\.\.$/,
+	      qr/^\(mt-matmul-4-smp\) Matrix results match expected values\.$/,
+	      qr/^\(mt-matmul-4-smp\) 1 thread took \d+ us, 4 threads took \d+ us: \d+\.\d\dx speedup\.$/,
+	      qr/^\(mt-matmul-4-smp\) end$/]);
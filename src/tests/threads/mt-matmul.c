@@ -4,10 +4,14 @@
 /* Based on UC Berkeley's RISC-V benchmark of the same name:
    https://github.com/ucb-bar/riscv-benchmarks/tree/master/mt-matmul */
 
+#include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include "tests/threads/tests.h"
 #include "tests/threads/matmul_data.h"
+#include "devices/timer.h"
 #include "threads/init.h"
+#include "threads/mp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 
@@ -18,6 +22,9 @@ void thread_entry(void* aux);
 
 static short results_data[ARRAY_SIZE];
 
+/* Upped by each thread when it finishes. */
+static struct semaphore done;
+
 struct thread_args {
   int tid;
   int n_threads;
@@ -39,6 +46,7 @@ void thread_entry(void* aux) {
   struct thread_args* args = (struct thread_args*)aux;
 
   matmul(args->tid, args->n_threads, DIM_SIZE, input1_data, input2_data, results_data);
+  sema_up(&done);
 }
 
 void test_mt_matmul(size_t num_threads) {
@@ -48,6 +56,8 @@ void test_mt_matmul(size_t num_threads) {
   ASSERT(thread_get_priority() == PRI_DEFAULT);
 
   struct thread_args args[num_threads];
+  memset(results_data, 0, sizeof results_data);
+  sema_init(&done, 0);
   for (size_t i = 0; i < num_threads; i++) {
     args[i].tid = i;
     args[i].n_threads = num_threads;
@@ -55,8 +65,11 @@ void test_mt_matmul(size_t num_threads) {
     thread_create("matmul", PRI_DEFAULT - 1, thread_entry, (void*)&args[i]);
   }
 
-  /* Let other threads run to completion */
+  /* Let other threads run to completion.  With more than one
+     CPU, we may run before they finish, so wait for them too. */
   thread_set_priority(PRI_DEFAULT - 2);
+  for (size_t i = 0; i < num_threads; i++)
+    sema_down(&done);
 
   int res = verifyDouble(ARRAY_SIZE, results_data, verify_data);
 
@@ -83,3 +96,23 @@ void test_mt_matmul_16(void) {
   msg("Executing blocked matmul with 16 threads...");
   test_mt_matmul(16);
 }
+/* Times the single-threaded matmul and then the 4-threaded one
+   on all the CPUs, and reports the speedup. */
+void test_mt_matmul_4_smp(void) {
+  uint64_t start, one_ns, four_ns, speedup;
+
+  msg("Executing single-threaded matmul...");
+  start = timer_ns();
+  test_mt_matmul(1);
+  one_ns = timer_ns() - start;
+
+  msg("Executing blocked matmul with 4 threads on %zu CPUs...", mp_online_cnt());
+  start = timer_ns();
+  test_mt_matmul(4);
+  four_ns = timer_ns() - start;
+
+  speedup = four_ns > 0 ? one_ns * 100 / four_ns : 0;
+  msg("1 thread took %" PRIu64 " us, 4 threads took %" PRIu64 " us: %" PRIu64 ".%02" PRIu64
+      "x speedup.",
+      one_ns / 1000, four_ns / 1000, speedup / 100, speedup % 100);
+}
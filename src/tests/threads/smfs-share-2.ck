@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(smfs-share-2) begin
+(smfs-share-2) Starting 2 threads...
+(smfs-share-2) Letting threads spin for 30 seconds, please wait...
+(smfs-share-2) Thread 0 got its share of the CPU.
+(smfs-share-2) Thread 1 got its share of the CPU.
+(smfs-share-2) end
+EOF
+pass;
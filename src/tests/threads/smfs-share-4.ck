@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(smfs-share-4) begin
+(smfs-share-4) Starting 4 threads...
+(smfs-share-4) Letting threads spin for 30 seconds, please wait...
+(smfs-share-4) Thread 0 got its share of the CPU.
+(smfs-share-4) Thread 1 got its share of the CPU.
+(smfs-share-4) Thread 2 got its share of the CPU.
+(smfs-share-4) Thread 3 got its share of the CPU.
+(smfs-share-4) end
+EOF
+pass;
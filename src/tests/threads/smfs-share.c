@@ -0,0 +1,105 @@
+/* Checks that the fair scheduler divides the CPU among busy
+   threads in proportion to their tickets, which are each
+   thread's priority plus one.
+
+   The smfs-share-2 test runs 2 threads with 32 and 64 tickets,
+   which should get 33.3% and 66.7% of the CPU.  The smfs-share-4
+   test runs 4 threads with 8, 16, 32, and 64 tickets, which
+   should get 6.7%, 13.3%, 26.7%, and 53.3%.
+
+   The threads start together and spin for 30 seconds.  Each
+   thread's CPU time is taken from the scheduler's own accounting
+   of the ticks it spent running, and its share of the total must
+   be within 3 percentage points of its share of the tickets. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void test_smfs_share(int thread_cnt);
+
+void test_smfs_share_2(void) { test_smfs_share(2); }
+
+void test_smfs_share_4(void) { test_smfs_share(4); }
+
+#define MAX_THREAD_CNT 4
+
+/* Largest allowed difference between a thread's share of the CPU
+   and its share of the tickets, in tenths of a percent. */
+#define MAX_ERROR 30
+
+struct thread_info {
+  int64_t run_ticks; /* Ticks spent running while spinning. */
+};
+
+static struct semaphore start_sema;
+static struct semaphore done_sema;
+static volatile bool stop;
+
+static void load_thread(void* aux);
+
+static void test_smfs_share(int thread_cnt) {
+  struct thread_info info[MAX_THREAD_CNT];
+  int tickets[MAX_THREAD_CNT];
+  int64_t total_ticks = 0;
+  int total_tickets = 0;
+  int i;
+
+  ASSERT(active_sched_policy == SCHED_FAIR);
+  ASSERT(thread_cnt <= MAX_THREAD_CNT);
+
+  thread_set_priority(PRI_MAX);
+  sema_init(&start_sema, 0);
+  sema_init(&done_sema, 0);
+  stop = false;
+
+  msg("Starting %d threads...", thread_cnt);
+  for (i = 0; i < thread_cnt; i++) {
+    char name[16];
+
+    tickets[i] = (PRI_MAX + 1) >> (thread_cnt - 1 - i);
+    total_tickets += tickets[i];
+    snprintf(name, sizeof name, "share %d", i);
+    thread_create(name, tickets[i] - 1, load_thread, &info[i]);
+  }
+
+  msg("Letting threads spin for 30 seconds, please wait...");
+  for (i = 0; i < thread_cnt; i++)
+    sema_up(&start_sema);
+  timer_sleep(30 * TIMER_FREQ);
+  stop = true;
+  for (i = 0; i < thread_cnt; i++)
+    sema_down(&done_sema);
+
+  for (i = 0; i < thread_cnt; i++)
+    total_ticks += info[i].run_ticks;
+  if (total_ticks == 0)
+    fail("Threads did not run.");
+  for (i = 0; i < thread_cnt; i++) {
+    int share = info[i].run_ticks * 1000 / total_ticks;
+    int expected = tickets[i] * 1000 / total_tickets;
+
+    if (share < expected - MAX_ERROR || share > expected + MAX_ERROR)
+      fail("Thread %d got %d.%d%% of the CPU, but it has %d.%d%% of the tickets.", i, share / 10,
+           share % 10, expected / 10, expected % 10);
+    msg("Thread %d got its share of the CPU.", i);
+  }
+}
+
+/* Waits to be started, then spins until told to stop and records
+   in TI_ how many ticks it spent running meanwhile. */
+static void load_thread(void* ti_) {
+  struct thread_info* ti = ti_;
+  int64_t start;
+
+  sema_down(&start_sema);
+  start = thread_current()->run_ticks;
+  while (!stop)
+    continue;
+  ti->run_ticks = thread_current()->run_ticks - start;
+  sema_up(&done_sema);
+}
@@ -1,6 +1,7 @@
 #include "tests/threads/tests.h"
 #include <test-lib.h>
 #include <debug.h>
+#include <stdbool.h>
 #include <string.h>
 
 static const struct test threads_tests[] = {
@@ -10,6 +11,7 @@ static const struct test threads_tests[] = {
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-stress", test_alarm_stress},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -28,6 +30,7 @@ static const struct test threads_tests[] = {
     {"mt-matmul-2", test_mt_matmul_2},
     {"mt-matmul-4", test_mt_matmul_4},
     {"mt-matmul-16", test_mt_matmul_16},
+    {"mt-matmul-4-smp", test_mt_matmul_4_smp},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -50,19 +53,49 @@ static const struct test threads_tests[] = {
     {"smfs-hierarchy-16", test_smfs_hierarchy_16},
     {"smfs-hierarchy-32", test_smfs_hierarchy_32},
     {"smfs-hierarchy-64", test_smfs_hierarchy_64},
-    {"smfs-hierarchy-256", test_smfs_hierarchy_256}};
+    {"smfs-hierarchy-256", test_smfs_hierarchy_256},
+    {"smfs-share-2", test_smfs_share_2},
+    {"smfs-share-4", test_smfs_share_4},
+    {"bench-spawn", test_bench_spawn},
+    {"bench-spawn-smp", test_bench_spawn},
+    {"bench-create", test_bench_create},
+    {"bench-pingpong", test_bench_pingpong},
+    {"bench-yield-2", test_bench_yield_2},
+    {"bench-yield-16", test_bench_yield_16},
+    {"bench-sleep", test_bench_sleep}};
 
-/* Runs the threads test named NAME. */
+static bool is_bench(const struct test* t);
+static void run_one(const struct test* t);
+
+/* Returns true if T is one of the benchmarks run by "bench".
+   The -smp variants run the same code as their plain twins and
+   differ only in how the kernel is booted, so they are left
+   out. */
+static bool is_bench(const struct test* t) {
+  size_t len = strlen(t->name);
+  return strstr(t->name, "bench-") == t->name && strcmp(t->name + len - 4, "-smp") != 0;
+}
+
+/* Runs the threads test named NAME.  The name "bench" runs
+   every bench-* test, one after another. */
 void run_threads_test(const char* name) {
   const struct test* t;
+  bool bench = !strcmp(name, "bench");
 
   for (t = threads_tests; t < threads_tests + sizeof threads_tests / sizeof *threads_tests; t++)
-    if (!strcmp(name, t->name)) {
-      test_name = name;
-      msg("begin");
-      t->function();
-      msg("end");
-      return;
+    if (bench ? is_bench(t) : !strcmp(name, t->name)) {
+      run_one(t);
+      if (!bench)
+        return;
     }
-  PANIC("no test named \"%s\"", name);
+  if (!bench)
+    PANIC("no test named \"%s\"", name);
+}
+
+/* Runs test T. */
+static void run_one(const struct test* t) {
+  test_name = t->name;
+  msg("begin");
+  t->function();
+  msg("end");
 }
@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_stress;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -29,6 +30,7 @@ extern test_func test_mt_matmul_1;
 extern test_func test_mt_matmul_2;
 extern test_func test_mt_matmul_4;
 extern test_func test_mt_matmul_16;
+extern test_func test_mt_matmul_4_smp;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -52,5 +54,13 @@ extern test_func test_smfs_hierarchy_16;
 extern test_func test_smfs_hierarchy_32;
 extern test_func test_smfs_hierarchy_64;
 extern test_func test_smfs_hierarchy_256;
+extern test_func test_smfs_share_2;
+extern test_func test_smfs_share_4;
+extern test_func test_bench_spawn;
+extern test_func test_bench_create;
+extern test_func test_bench_pingpong;
+extern test_func test_bench_yield_2;
+extern test_func test_bench_yield_16;
+extern test_func test_bench_sleep;
 
 #endif /* tests/threads/tests.h */
@@ -0,0 +1,140 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/mp.h"
+#include "threads/thread.h"
+
+/* Lazy FPU context switching.
+
+   Most threads never execute a floating-point instruction, so
+   the FPU state is not saved and restored on every context
+   switch.  Instead, each CPU's FPU registers belong to one
+   thread, its fpu_owner, and switching to any other thread sets
+   the TS ("task switched") bit in CR0.  The next FPU instruction
+   then raises #NM (device not available), whose handler saves
+   the owner's state into the owner's struct thread, loads the
+   current thread's, and makes it the owner.  A thread that never
+   uses the FPU never pays for it.
+
+   A thread that switches away may next run on another CPU, which
+   could not reach the state left in this CPU's registers.  So
+   when more than one CPU runs threads, a thread's state is saved
+   as soon as it switches away, and only the restore is lazy.
+
+   A user process's FPU state lives in the same registers while
+   the kernel handles its traps, so kernel code that uses the FPU
+   on a process's behalf must bracket that use with
+   fpu_kernel_begin() and fpu_kernel_end().  Interrupt handlers
+   must not use the FPU at all. */
+
+/* CR0 bit that makes FPU instructions raise #NM. */
+#define CR0_TS 0x00000008
+
+static intr_handler_func fpu_trap;
+static void fpu_claim(void);
+
+/* Sets CR0's TS bit. */
+static inline void set_ts(void) {
+  uint32_t cr0;
+  asm volatile("movl %%cr0, %0" : "=r"(cr0));
+  asm volatile("movl %0, %%cr0" : : "r"(cr0 | CR0_TS));
+}
+
+/* Clears CR0's TS bit. */
+static inline void clear_ts(void) { asm volatile("clts"); }
+
+/* Registers the #NM handler and gives the FPU to no thread. */
+void fpu_init(void) {
+  intr_register_int(7, 0, INTR_OFF, fpu_trap, "#NM Device Not Available Exception");
+  cpu_current()->fpu_owner = NULL;
+  set_ts();
+}
+
+/* Gives the running application processor's FPU to no thread. */
+void fpu_init_ap(void) {
+  cpu_current()->fpu_owner = NULL;
+  set_ts();
+}
+
+/* Called by the scheduler after switching from PREV, or a null
+   pointer if it did not switch threads, to CUR.  Lets CUR use
+   the FPU directly if it already owns it, and makes its next FPU
+   instruction trap otherwise. */
+void fpu_switch(struct thread* prev, struct thread* cur) {
+  struct cpu* c = cpu_current();
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (prev != NULL && c->fpu_owner == prev && cpu_cnt > 1) {
+    clear_ts();
+    asm volatile("fnsave %0" : "=m"(prev->fpu));
+    c->fpu_owner = NULL;
+  }
+
+  if (c->fpu_owner == cur)
+    clear_ts();
+  else
+    set_ts();
+}
+
+/* Called when thread T is about to be destroyed.  Discards its
+   FPU state, so that its page can be reused. */
+void fpu_exit(struct thread* t) {
+  struct cpu* c = cpu_current();
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (c->fpu_owner == t)
+    c->fpu_owner = NULL;
+}
+
+/* Saves the current thread's FPU state into SAVE and gives the
+   kernel a freshly initialized FPU. */
+void fpu_kernel_begin(uint8_t save[FPU_SAVE_SIZE]) {
+  enum intr_level old_level = intr_disable();
+
+  fpu_claim();
+  asm volatile("fnsave %0" : "=m"(*(uint8_t(*)[FPU_SAVE_SIZE])save));
+  intr_set_level(old_level);
+}
+
+/* Restores the FPU state saved in SAVE by fpu_kernel_begin(). */
+void fpu_kernel_end(const uint8_t save[FPU_SAVE_SIZE]) {
+  enum intr_level old_level = intr_disable();
+
+  fpu_claim();
+  asm volatile("frstor %0" : : "m"(*(const uint8_t(*)[FPU_SAVE_SIZE])save));
+  intr_set_level(old_level);
+}
+
+/* #NM handler: the running thread used the FPU while it belonged
+   to another thread. */
+static void fpu_trap(struct intr_frame* f UNUSED) {
+  if (intr_context())
+    PANIC("FPU used in an interrupt handler");
+  fpu_claim();
+}
+
+/* Loads the running thread's FPU state into this CPU's FPU,
+   saving the previous owner's, and lets the running thread use
+   the FPU directly.  A thread's first use gets an initialized
+   FPU. */
+static void fpu_claim(void) {
+  struct cpu* c = cpu_current();
+  struct thread* cur = thread_current();
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  clear_ts();
+  if (c->fpu_owner == cur)
+    return;
+  if (c->fpu_owner != NULL)
+    asm volatile("fnsave %0" : "=m"(c->fpu_owner->fpu));
+  if (cur->fpu_used)
+    asm volatile("frstor %0" : : "m"(cur->fpu));
+  else {
+    asm volatile("fninit");
+    cur->fpu_used = true;
+  }
+  c->fpu_owner = cur;
+}
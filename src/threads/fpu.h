@@ -0,0 +1,18 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdint.h>
+
+struct thread;
+
+/* Size of the x87 FPU state saved by FSAVE. */
+#define FPU_SAVE_SIZE 108
+
+void fpu_init(void);
+void fpu_init_ap(void);
+void fpu_switch(struct thread* prev, struct thread* cur);
+void fpu_exit(struct thread* t);
+void fpu_kernel_begin(uint8_t save[FPU_SAVE_SIZE]);
+void fpu_kernel_end(const uint8_t save[FPU_SAVE_SIZE]);
+
+#endif /* threads/fpu.h */
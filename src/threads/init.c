@@ -16,10 +16,12 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/mp.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
@@ -37,6 +39,9 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/iosched.h"
+#include "devices/raid0.h"
+#include "devices/ramdisk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -52,11 +57,22 @@ static bool format_filesys;
    overriding the defaults. */
 static const char* filesys_bdev_name;
 static const char* scratch_bdev_name;
+
+/* -raid0: Comma-separated names of the block devices to stripe
+   together as "md0", or null. */
+static const char* raid0_members;
+
+/* -ramdisk: Size of the RAM disk to create, in kB, or 0 for
+   none. */
+static size_t ramdisk_kb;
 #ifdef VM
 static const char* swap_bdev_name;
 #endif
 #endif /* FILESYS */
 
+/* -smp: Start the application processors? */
+static bool smp;
+
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
@@ -106,6 +122,7 @@ int main(void) {
 
   /* Initialize interrupt handlers. */
   intr_init();
+  fpu_init();
   timer_init();
   kbd_init();
   input_init();
@@ -118,6 +135,8 @@ int main(void) {
   thread_start();
   serial_init_queue();
   timer_calibrate();
+  if (smp)
+    mp_init();
 
 #ifdef USERPROG
   /* Give main thread a minimal PCB so it can launch the first process */
@@ -127,6 +146,10 @@ int main(void) {
 #ifdef FILESYS
   /* Initialize file system. */
   ide_init();
+  if (ramdisk_kb > 0)
+    ramdisk_init(ramdisk_kb);
+  if (raid0_members != NULL)
+    raid0_init(raid0_members);
   locate_block_devices();
   filesys_init(format_filesys);
 #endif
@@ -241,11 +264,25 @@ static char** parse_options(char** argv) {
       filesys_bdev_name = value;
     else if (!strcmp(name, "-scratch"))
       scratch_bdev_name = value;
+    else if (!strcmp(name, "-blktrace"))
+      block_trace_enable();
+    else if (!strcmp(name, "-ramdisk"))
+      ramdisk_kb = value != NULL ? atoi(value) : 0;
+    else if (!strcmp(name, "-raid0"))
+      raid0_members = value;
+    else if (!strcmp(name, "-iosched")) {
+      if (value == NULL || !iosched_select(value))
+        PANIC("unknown I/O scheduler `%s' (use -h for help)", value != NULL ? value : "");
+    }
 #ifdef VM
     else if (!strcmp(name, "-swap"))
       swap_bdev_name = value;
 #endif
 #endif
+    else if (!strcmp(name, "-tickless"))
+      timer_enable_tickless();
+    else if (!strcmp(name, "-smp"))
+      smp = true;
     else if (!strcmp(name, "-rs"))
       random_init(atoi(value));
     else if (!strcmp(name, "-sched")) {
@@ -421,10 +458,17 @@ static void usage(void) {
          "  -f                 Format file system device during startup.\n"
          "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
          "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+         "  -blktrace          Record block requests for the blktrace system call.\n"
+         "  -ramdisk=SIZE      Create a SIZE kB RAM disk named ramdisk.\n"
+         "  -raid0=BDEV,BDEV.. Stripe the given block devices together as md0.\n"
+         "  -iosched=POLICY    Order disk requests by POLICY: noop, clook, or deadline\n"
+         "                     (the default).\n"
 #ifdef VM
          "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif // VM
 #endif // FILESYS
+         "  -tickless          Program the timer only for the next event, not every tick.\n"
+         "  -smp               Start the other CPUs and run threads on all of them.\n"
          "  -rs=SEED           Set random number seed to SEED.\n"
          "  -sched-fair        Use alternate non-strict priority scheduler. Mutually exclusive "
          "with \"-sched-mlfqs\", \"-sched-prio\".\n"
@@ -6,8 +6,11 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/mp.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
@@ -24,11 +27,38 @@
 /* Number of x86 interrupts. */
 #define INTR_CNT 256
 
-/* The Interrupt Descriptor Table (IDT).  The format is fixed by
-   the CPU.  See [IA32-v3a] sections 5.10 "Interrupt Descriptor
-   Table (IDT)", 5.11 "IDT Descriptors", 5.12.1.2 "Flag Usage By
-   Exception- or Interrupt-Handler Procedure". */
-static uint64_t idt[INTR_CNT];
+/* The Interrupt Descriptor Table (IDT), one for each CPU.  The
+   format is fixed by the CPU.  See [IA32-v3a] sections 5.10
+   "Interrupt Descriptor Table (IDT)", 5.11 "IDT Descriptors",
+   5.12.1.2 "Flag Usage By Exception- or Interrupt-Handler
+   Procedure".  Every CPU's table has the same gates. */
+static uint64_t idt[MP_MAX_CPUS][INTR_CNT];
+
+/* Interrupt lock.
+
+   The kernel protects its data by disabling interrupts, which
+   only excludes other code on the same CPU.  To exclude the
+   other CPUs too, a CPU holds this lock exactly while it has
+   interrupts off: intr_disable() acquires it and intr_enable()
+   releases it, and intr_handler() does the same for interrupts
+   that turn interrupts off on entry or back on at return.  So
+   all the code that runs with interrupts off, including the
+   synchronization primitives in synch.c and the device drivers,
+   runs on one CPU at a time.  That makes it a big kernel lock:
+   a CPU that busy-waits with interrupts off holds up every other
+   CPU that wants to turn them off, so such waits must be short.
+
+   The scheduler does not need it.  Its ready queues have locks
+   of their own, so schedule() drops the interrupt lock with
+   intr_unlock() while it picks the next thread and switches to
+   it, and CPUs that only schedule never wait for each other
+   here.
+
+   The lock belongs to a CPU, not a thread: a thread that blocks
+   with interrupts off hands it to the thread switched to, which
+   releases it when it turns interrupts on.  It starts out held,
+   because the bootstrap CPU starts with interrupts off. */
+static struct spinlock intr_lock = {1};
 
 /* Interrupt handler functions for each interrupt. */
 static intr_handler_func* intr_handlers[INTR_CNT];
@@ -47,8 +77,8 @@ static unsigned int unexpected_cnt[INTR_CNT];
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
    interrupt returns. */
-static bool in_external_intr; /* Are we processing an external interrupt? */
-static bool yield_on_return;  /* Should we yield on interrupt return? */
+static bool in_external_intr[MP_MAX_CPUS]; /* Is each CPU processing an external interrupt? */
+static bool yield_on_return[MP_MAX_CPUS];  /* Should each CPU yield on interrupt return? */
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init(void);
@@ -87,11 +117,14 @@ enum intr_level intr_enable(void) {
   enum intr_level old_level = intr_get_level();
   ASSERT(!intr_context());
 
+  if (old_level == INTR_OFF)
+    spin_unlock(&intr_lock);
+
   /* Enable interrupts by setting the interrupt flag.
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
      Hardware Interrupts". */
-  asm volatile("sti");
+  asm volatile("sti" : : : "memory");
 
   return old_level;
 }
@@ -105,25 +138,65 @@ enum intr_level intr_disable(void) {
      Hardware Interrupts". */
   asm volatile("cli" : : : "memory");
 
+  if (old_level == INTR_ON)
+    spin_lock(&intr_lock);
+
   return old_level;
 }
 
+/* Enables interrupts and waits for the next one to arrive.
+   Interrupts must be off.
+
+   The `sti' instruction disables interrupts until the
+   completion of the next instruction, so `sti; hlt' is executed
+   atomically.  This atomicity is important; otherwise, an
+   interrupt could be handled between re-enabling interrupts and
+   waiting for the next one to occur, wasting as much as one
+   clock tick worth of time.
+
+   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
+   7.11.1 "HLT Instruction". */
+void intr_wait(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(!intr_context());
+
+  spin_unlock(&intr_lock);
+  asm volatile("sti; hlt" : : : "memory");
+}
+
+/* Releases the interrupt lock, leaving interrupts off.  Until
+   intr_relock(), the running CPU may only touch data that has a
+   lock of its own, such as the scheduler's ready queues. */
+void intr_unlock(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  spin_unlock(&intr_lock);
+}
+
+/* Reacquires the interrupt lock released by intr_unlock(). */
+void intr_relock(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  spin_lock(&intr_lock);
+}
+
 /* Initializes the interrupt system. */
 void intr_init(void) {
   uint64_t idtr_operand;
-  int i;
+  int cpu, i;
 
   /* Initialize interrupt controller. */
   pic_init();
 
-  /* Initialize IDT. */
-  for (i = 0; i < INTR_CNT; i++)
-    idt[i] = make_intr_gate(intr_stubs[i], 0);
+  /* Initialize IDTs. */
+  for (cpu = 0; cpu < MP_MAX_CPUS; cpu++)
+    for (i = 0; i < INTR_CNT; i++)
+      idt[cpu][i] = make_intr_gate(intr_stubs[i], 0);
 
   /* Load IDT register.
      See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
      Descriptor Table (IDT)". */
-  idtr_operand = make_idtr_operand(sizeof idt - 1, idt);
+  idtr_operand = make_idtr_operand(sizeof idt[0] - 1, idt[0]);
   asm volatile("lidt %0" : : "m"(idtr_operand));
 
   /* Initialize intr_names. */
@@ -150,17 +223,35 @@ void intr_init(void) {
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Sets up interrupts on application processor CPU, which has
+   just started with interrupts off: takes the interrupt lock,
+   which every CPU with interrupts off holds, and loads CPU's
+   IDT. */
+void intr_init_ap(int cpu) {
+  uint64_t idtr_operand;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(cpu > 0 && cpu < MP_MAX_CPUS);
+
+  spin_lock(&intr_lock);
+  idtr_operand = make_idtr_operand(sizeof idt[cpu] - 1, idt[cpu]);
+  asm volatile("lidt %0" : : "m"(idtr_operand));
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
    interrupt status set to LEVEL. */
 static void register_handler(uint8_t vec_no, int dpl, enum intr_level level,
                              intr_handler_func* handler, const char* name) {
+  int cpu;
+
   ASSERT(intr_handlers[vec_no] == NULL);
-  if (level == INTR_ON)
-    idt[vec_no] = make_trap_gate(intr_stubs[vec_no], dpl);
-  else
-    idt[vec_no] = make_intr_gate(intr_stubs[vec_no], dpl);
+  for (cpu = 0; cpu < MP_MAX_CPUS; cpu++)
+    if (level == INTR_ON)
+      idt[cpu][vec_no] = make_trap_gate(intr_stubs[vec_no], dpl);
+    else
+      idt[cpu][vec_no] = make_intr_gate(intr_stubs[vec_no], dpl);
   intr_handlers[vec_no] = handler;
   intr_names[vec_no] = name;
 }
@@ -173,6 +264,16 @@ void intr_register_ext(uint8_t vec_no, intr_handler_func* handler, const char* n
   register_handler(vec_no, 0, INTR_OFF, handler, name);
 }
 
+/* Registers local APIC interrupt VEC_NO, which must be between
+   INTR_LAPIC_MIN and INTR_LAPIC_MAX, to invoke HANDLER, which is
+   named NAME for debugging purposes.  Such interrupts come from
+   the running CPU's own local APIC, such as its timer, or from
+   another CPU, and are handled like external interrupts. */
+void intr_register_lapic(uint8_t vec_no, intr_handler_func* handler, const char* name) {
+  ASSERT(vec_no >= INTR_LAPIC_MIN && vec_no <= INTR_LAPIC_MAX);
+  register_handler(vec_no, 0, INTR_OFF, handler, name);
+}
+
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The interrupt handler
    will be invoked with interrupt status LEVEL.
@@ -189,12 +290,17 @@ void intr_register_ext(uint8_t vec_no, intr_handler_func* handler, const char* n
 void intr_register_int(uint8_t vec_no, int dpl, enum intr_level level, intr_handler_func* handler,
                        const char* name) {
   ASSERT(vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT(vec_no < INTR_LAPIC_MIN || vec_no > INTR_LAPIC_MAX);
   register_handler(vec_no, dpl, level, handler, name);
 }
 
 /* Returns true during processing of an external interrupt
-   and false at all other times. */
-bool intr_context(void) { return in_external_intr; }
+   and false at all other times.  External interrupts are
+   handled with interrupts off, so the running thread cannot
+   move to another CPU while this checks its CPU's flag. */
+bool intr_context(void) {
+  return intr_get_level() == INTR_OFF && in_external_intr[cpu_current()->id];
+}
 
 /* During processing of an external interrupt, directs the
    interrupt handler to yield to a new process just before
@@ -202,7 +308,7 @@ bool intr_context(void) { return in_external_intr; }
    time. */
 void intr_yield_on_return(void) {
   ASSERT(intr_context());
-  yield_on_return = true;
+  yield_on_return[cpu_current()->id] = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -317,27 +423,37 @@ static inline bool is_trap_from_userspace(struct intr_frame* frame) {
    intr-stubs.S.  FRAME describes the interrupt and the
    interrupted thread's registers. */
 void intr_handler(struct intr_frame* frame) {
-  bool external;
+  bool external, lapic;
   intr_handler_func* handler;
+  int cpu;
+
+  /* An interrupt gate turned interrupts off, so this CPU must
+     now hold the interrupt lock, unless the interrupted code
+     already did. */
+  if ((frame->eflags & FLAG_IF) && intr_get_level() == INTR_OFF)
+    spin_lock(&intr_lock);
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or the local
+     APIC (see below).  An external interrupt handler cannot
+     sleep. */
+  lapic = frame->vec_no >= INTR_LAPIC_MIN && frame->vec_no <= INTR_LAPIC_MAX;
+  external = (frame->vec_no >= 0x20 && frame->vec_no < 0x30) || lapic;
   if (external) {
     ASSERT(intr_get_level() == INTR_OFF);
     ASSERT(!intr_context());
 
-    in_external_intr = true;
-    yield_on_return = false;
+    cpu = cpu_current()->id;
+    in_external_intr[cpu] = true;
+    yield_on_return[cpu] = false;
   }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler(frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f) {
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f || frame->vec_no == INTR_SPURIOUS) {
     /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
          condition.  Ignore it. */
@@ -349,12 +465,24 @@ void intr_handler(struct intr_frame* frame) {
     ASSERT(intr_get_level() == INTR_OFF);
     ASSERT(intr_context());
 
-    in_external_intr = false;
-    pic_end_of_interrupt(frame->vec_no);
+    in_external_intr[cpu] = false;
+    if (lapic)
+      lapic_eoi();
+    else
+      pic_end_of_interrupt(frame->vec_no);
 
-    if (yield_on_return)
-      thread_yield();
+    /* The running thread may be on another CPU once it yields. */
+    if (yield_on_return[cpu])
+      thread_yield_preempted();
   }
+
+  /* Leave the interrupt lock as the interrupted code expects it:
+     held if it had interrupts off, released if it had them on.
+     The `iret' in intr_exit restores its interrupt flag. */
+  if (!(frame->eflags & FLAG_IF) && intr_get_level() == INTR_ON)
+    intr_disable();
+  else if ((frame->eflags & FLAG_IF) && intr_get_level() == INTR_OFF)
+    spin_unlock(&intr_lock);
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
@@ -14,6 +14,15 @@ enum intr_level intr_get_level(void);
 enum intr_level intr_set_level(enum intr_level);
 enum intr_level intr_enable(void);
 enum intr_level intr_disable(void);
+void intr_wait(void);
+void intr_unlock(void);
+void intr_relock(void);
+
+/* Vectors raised by the local APICs, handled like external
+   interrupts.  The PICs use 0x20...0x2f and system calls 0x30. */
+#define INTR_LAPIC_MIN 0x40
+#define INTR_LAPIC_MAX 0x4f
+#define INTR_SPURIOUS 0xff /* Local APIC spurious interrupt. */
 
 /* Interrupt stack frame. */
 struct intr_frame {
@@ -31,7 +40,6 @@ struct intr_frame {
   uint16_t fs, : 16;  /* Saved FS segment register. */
   uint16_t es, : 16;  /* Saved ES segment register. */
   uint16_t ds, : 16;  /* Saved DS segment register. */
-  char fpu[108];
 
   /* Pushed by intrNN_stub in intr-stubs.S. */
   uint32_t vec_no; /* Interrupt vector number. */
@@ -57,7 +65,9 @@ struct intr_frame {
 typedef void intr_handler_func(struct intr_frame*);
 
 void intr_init(void);
+void intr_init_ap(int cpu);
 void intr_register_ext(uint8_t vec, intr_handler_func*, const char* name);
+void intr_register_lapic(uint8_t vec, intr_handler_func*, const char* name);
 void intr_register_int(uint8_t vec, int dpl, enum intr_level, intr_handler_func*, const char* name);
 bool intr_context(void);
 void intr_yield_on_return(void);
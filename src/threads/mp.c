@@ -0,0 +1,363 @@
+#include "threads/mp.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/tss.h"
+#endif
+
+/* Multiprocessor startup.
+
+   Finds the CPUs listed in the BIOS's MultiProcessor
+   Specification tables and starts each application processor
+   (AP) with the INIT-SIPI-SIPI sequence, running the trampoline
+   in ap-start.S.
+
+   Every CPU runs threads.  Each AP gets its own IDT, GDT, and
+   TSS, turns its startup stack into its idle thread, and then
+   schedules threads from the ready queues like the bootstrap
+   processor (BSP).  Each CPU's ready queue has its own lock, but
+   the rest of the code that runs with interrupts off holds the
+   interrupt lock (see threads/interrupt.c), so outside the
+   scheduler the kernel's data is still only touched by one CPU
+   at a time.  The BSP takes the
+   timer and device interrupts; each AP's local APIC timer ticks
+   at the same rate to preempt its threads, and a CPU that queues
+   a thread for an idle CPU wakes it with an IPI.
+
+   See [MP] "Intel MultiProcessor Specification", version 1.4. */
+
+/* Physical address of the page that APs start at.  It must be
+   below 1 MB, where palloc never hands out memory, and clear of
+   the loader (0x7c00), the initial thread (0xe000), and the
+   page directory that start.S built (0xf000). */
+#define AP_START_PADDR 0x8000
+
+/* MP floating pointer structure. */
+struct mp_fps {
+  char signature[4];  /* "_MP_". */
+  uint32_t config;    /* Physical address of configuration table. */
+  uint8_t length;     /* Length in 16-byte units. */
+  uint8_t spec_rev;   /* Specification revision. */
+  uint8_t checksum;   /* Makes all bytes sum to 0. */
+  uint8_t feature[5]; /* Feature bytes; nonzero first byte means a default configuration. */
+} __attribute__((packed));
+
+/* MP configuration table header. */
+struct mp_config {
+  char signature[4];     /* "PCMP". */
+  uint16_t length;       /* Length of base table, including header. */
+  uint8_t spec_rev;      /* Specification revision. */
+  uint8_t checksum;      /* Makes all bytes of base table sum to 0. */
+  char oem_id[8];        /* OEM identifier. */
+  char product_id[12];   /* Product identifier. */
+  uint32_t oem_table;    /* Physical address of OEM table. */
+  uint16_t oem_length;   /* Length of OEM table. */
+  uint16_t entry_cnt;    /* Number of entries in base table. */
+  uint32_t lapic_paddr;  /* Physical address of local APICs. */
+  uint16_t ext_length;   /* Length of extended table. */
+  uint8_t ext_checksum;  /* Checksum of extended table. */
+  uint8_t reserved;
+} __attribute__((packed));
+
+/* MP configuration table processor entry. */
+struct mp_processor {
+  uint8_t type;       /* MP_PROCESSOR. */
+  uint8_t apic_id;    /* Local APIC ID. */
+  uint8_t apic_ver;   /* Local APIC version. */
+  uint8_t flags;      /* MP_CPU_* flags. */
+  uint32_t signature; /* CPU signature. */
+  uint32_t features;  /* CPU feature flags. */
+  uint32_t reserved[2];
+} __attribute__((packed));
+
+#define MP_PROCESSOR 0       /* Processor entry type. */
+#define MP_CPU_ENABLED 0x01  /* Processor is usable. */
+#define MP_CPU_BSP 0x02      /* Processor is the bootstrap processor. */
+#define MP_ENTRY_SIZE 8      /* Size of every other entry type. */
+#define MP_DEFAULT_LAPIC 0xfee00000
+
+/* Local APIC interrupt vectors. */
+#define MP_TIMER_VEC (INTR_LAPIC_MIN + 0) /* Local APIC timer. */
+#define MP_WAKE_VEC (INTR_LAPIC_MIN + 1)  /* Wakes an idle CPU. */
+
+/* Per-CPU data, indexed by CPU number. */
+struct cpu cpus[MP_MAX_CPUS];
+size_t cpu_cnt;
+
+/* Protects online_cnt, which APs update as they come up. */
+static struct spinlock online_lock;
+static size_t online_cnt;
+
+/* Local APIC timer ticks of each AP. */
+static int64_t ap_ticks[MP_MAX_CPUS];
+
+/* Trampoline in ap-start.S. */
+extern char ap_start[], ap_start_end[], ap_cr3[], ap_stack[];
+
+void ap_main(void) NO_RETURN;
+
+static struct mp_fps* fps_search(uintptr_t paddr, size_t size);
+static struct mp_fps* fps_find(void);
+static bool checksum_ok(const void* p, size_t size);
+static bool config_read(const struct mp_fps* fps, uintptr_t* lapic_paddr);
+static bool start_ap(struct cpu* c, uint8_t* trampoline);
+static struct cpu* cpu_lookup(uint8_t apic_id);
+static intr_handler_func ap_timer_interrupt;
+static intr_handler_func wake_interrupt;
+
+/* Finds the CPUs in the system and starts the application
+   processors, which then start running threads.  Must be called
+   with the timer calibrated and before any user process is
+   created. */
+void mp_init(void) {
+  struct mp_fps* fps = fps_find();
+  uintptr_t lapic_paddr;
+  uint32_t* identity_pt;
+  uint8_t* trampoline;
+  struct cpu bsp;
+  size_t i;
+
+  if (fps == NULL || !config_read(fps, &lapic_paddr)) {
+    printf("SMP: no usable MP configuration table, running on 1 CPU.\n");
+    return;
+  }
+
+  lapic_init(lapic_paddr);
+  lapic_enable();
+
+  /* The running thread, like every thread so far, is on CPU 0,
+     so the BSP must be cpus[0]. */
+  bsp = *cpu_lookup(lapic_id());
+  cpus[bsp.id] = cpus[0];
+  cpus[0] = bsp;
+  for (i = 0; i < cpu_cnt; i++) {
+    cpus[i].id = i;
+    cpus[i].bsp = i == 0;
+  }
+  cpus[0].online = true;
+  spin_init(&online_lock);
+  online_cnt = 1;
+
+  lapic_timer_calibrate();
+  intr_register_lapic(MP_TIMER_VEC, ap_timer_interrupt, "Local APIC Timer");
+  intr_register_lapic(MP_WAKE_VEC, wake_interrupt, "Wake-up IPI");
+
+  /* Copy the trampoline into low memory and map it at its
+     physical address. */
+  ASSERT(ap_start_end - ap_start <= PGSIZE);
+  trampoline = ptov(AP_START_PADDR);
+  memcpy(trampoline, ap_start, ap_start_end - ap_start);
+  *(uint32_t*)(trampoline + (ap_cr3 - ap_start)) = vtop(init_page_dir);
+  identity_pt = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  identity_pt[pt_no((void*)AP_START_PADDR)] = AP_START_PADDR | PTE_P;
+  init_page_dir[pd_no((void*)AP_START_PADDR)] = pde_create(identity_pt);
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (!cpus[i].bsp && !start_ap(&cpus[i], trampoline)) {
+      /* A processor that starts late could take the next one's
+         stack, so give up on the rest. */
+      printf("SMP: CPU %d (APIC ID %u) did not start.\n", cpus[i].id, cpus[i].apic_id);
+      break;
+    }
+
+  /* Remove the identity mapping, which user page directories
+     must not inherit. */
+  init_page_dir[pd_no((void*)AP_START_PADDR)] = 0;
+  asm volatile("movl %0, %%cr3" : : "r"(vtop(init_page_dir)) : "memory");
+  palloc_free_page(identity_pt);
+
+  printf("SMP: %zu of %zu CPUs online.\n", mp_online_cnt(), cpu_cnt);
+}
+
+/* Returns the running CPU's per-CPU data.  Unless interrupts are
+   off, the running thread may be moved to another CPU at any
+   time. */
+struct cpu* cpu_current(void) {
+  if (cpu_cnt <= 1)
+    return &cpus[0];
+  return &cpus[thread_cpu()];
+}
+
+/* Interrupts CPU, which must be online and not the running CPU,
+   so that it stops waiting for an interrupt and looks for a
+   thread to run. */
+void mp_wake(int cpu) {
+  ASSERT(cpu >= 0 && (size_t)cpu < cpu_cnt && cpus[cpu].online);
+  lapic_send_ipi(cpus[cpu].apic_id, MP_WAKE_VEC);
+}
+
+/* Returns the number of CPUs that are online. */
+size_t mp_online_cnt(void) {
+  enum intr_level old_level = spin_lock_irqsave(&online_lock);
+  size_t cnt = cpu_cnt > 0 ? online_cnt : 1;
+  spin_unlock_irqrestore(&online_lock, old_level);
+  return cnt;
+}
+
+/* Entry point of an application processor, called by ap-start.S
+   on the CPU's own stack with interrupts off.  Until it holds the
+   interrupt lock it must not touch anything shared, and until it
+   is a thread it must not call cpu_current(). */
+void ap_main(void) {
+  struct cpu* c;
+
+  lapic_enable();
+  c = cpu_lookup(lapic_id());
+  intr_init_ap(c->id);
+  thread_init_ap(c->id);
+#ifdef USERPROG
+  tss_init();
+  gdt_init();
+#endif
+  fpu_init_ap();
+  lapic_timer_start(MP_TIMER_VEC);
+
+  spin_lock(&online_lock);
+  online_cnt++;
+  c->online = true;
+  spin_unlock(&online_lock);
+
+  thread_start_ap();
+}
+
+/* Returns the per-CPU data of the CPU with local APIC ID
+   APIC_ID. */
+static struct cpu* cpu_lookup(uint8_t apic_id) {
+  size_t i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].apic_id == apic_id)
+      return &cpus[i];
+  PANIC("running on unknown CPU with APIC ID %u", apic_id);
+}
+
+/* Local APIC timer interrupt handler of an application
+   processor.  Each AP counts its own ticks. */
+static void ap_timer_interrupt(struct intr_frame* args UNUSED) {
+  thread_tick(++ap_ticks[thread_cpu()]);
+}
+
+/* Wake-up IPI handler.  Interrupting the idle loop's `hlt' is
+   all it takes: the idle thread then calls the scheduler. */
+static void wake_interrupt(struct intr_frame* args UNUSED) {}
+
+/* Starts application processor C with the INIT-SIPI-SIPI
+   sequence, giving it a new stack page, which becomes its idle
+   thread, and waits for it to come online.  Returns true if it
+   did. */
+static bool start_ap(struct cpu* c, uint8_t* trampoline) {
+  int i;
+
+  c->stack = palloc_get_page(PAL_ZERO);
+  if (c->stack == NULL)
+    return false;
+  *(uint32_t*)(trampoline + (ap_stack - ap_start)) = (uint32_t)(c->stack + PGSIZE);
+
+  /* See [MP] appendix B.4 "Application Processor Startup". */
+  lapic_send_init(c->apic_id);
+  timer_mdelay(10);
+  for (i = 0; i < 2 && !c->online; i++) {
+    lapic_send_startup(c->apic_id, AP_START_PADDR);
+    timer_udelay(200);
+  }
+
+  /* Give it up to 100 ms to report in. */
+  for (i = 0; i < 100 && !c->online; i++)
+    timer_mdelay(1);
+  return c->online;
+}
+
+/* Finds the MP floating pointer structure in the places [MP]
+   section 4 says to look: the first kB of the extended BIOS data
+   area, the last kB of base memory, and the BIOS ROM. */
+static struct mp_fps* fps_find(void) {
+  uintptr_t ebda = *(uint16_t*)ptov(0x40e) << 4;
+  uintptr_t base_kb = *(uint16_t*)ptov(0x413);
+  struct mp_fps* fps = NULL;
+
+  if (ebda != 0)
+    fps = fps_search(ebda, 1024);
+  if (fps == NULL && base_kb != 0)
+    fps = fps_search(base_kb * 1024 - 1024, 1024);
+  if (fps == NULL)
+    fps = fps_search(0xf0000, 0x10000);
+  return fps;
+}
+
+/* Searches SIZE bytes of physical memory at PADDR for a valid
+   MP floating pointer structure, which is aligned on a 16-byte
+   boundary. */
+static struct mp_fps* fps_search(uintptr_t paddr, size_t size) {
+  uint8_t* p = ptov(paddr);
+  uint8_t* end = p + size;
+
+  for (; p + sizeof(struct mp_fps) <= end; p += 16)
+    if (!memcmp(p, "_MP_", 4) && checksum_ok(p, sizeof(struct mp_fps)))
+      return (struct mp_fps*)p;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0 modulo 256. */
+static bool checksum_ok(const void* p, size_t size) {
+  const uint8_t* bytes = p;
+  uint8_t sum = 0;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    sum += bytes[i];
+  return sum == 0;
+}
+
+/* Reads the processor entries of the MP configuration table
+   pointed to by FPS into cpus[] and stores the physical address
+   of the local APICs into *LAPIC_PADDR.  Returns false if the
+   table is missing, invalid, or not in mapped memory. */
+static bool config_read(const struct mp_fps* fps, uintptr_t* lapic_paddr) {
+  const struct mp_config* config;
+  const uint8_t* entry;
+  size_t i;
+
+  /* Default configurations (no table) describe two CPUs with
+     fixed APIC IDs, but no emulator or machine we run on uses
+     them. */
+  if (fps->config == 0 || fps->feature[0] != 0)
+    return false;
+  if (fps->config + sizeof *config > init_ram_pages * PGSIZE)
+    return false;
+  config = ptov(fps->config);
+  if (memcmp(config->signature, "PCMP", 4) != 0)
+    return false;
+  if (fps->config + config->length > init_ram_pages * PGSIZE)
+    return false;
+  if (!checksum_ok(config, config->length))
+    return false;
+
+  *lapic_paddr = config->lapic_paddr != 0 ? config->lapic_paddr : MP_DEFAULT_LAPIC;
+  entry = (const uint8_t*)(config + 1);
+  for (i = 0; i < config->entry_cnt; i++) {
+    if (*entry == MP_PROCESSOR) {
+      const struct mp_processor* proc = (const struct mp_processor*)entry;
+      if ((proc->flags & MP_CPU_ENABLED) && cpu_cnt < MP_MAX_CPUS) {
+        struct cpu* c = &cpus[cpu_cnt];
+        c->id = cpu_cnt++;
+        c->apic_id = proc->apic_id;
+      }
+      entry += sizeof *proc;
+    } else
+      entry += MP_ENTRY_SIZE;
+  }
+  return cpu_cnt > 0;
+}
@@ -0,0 +1,31 @@
+#ifndef THREADS_MP_H
+#define THREADS_MP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Maximum number of CPUs supported. */
+#define MP_MAX_CPUS 8
+
+/* Per-CPU data. */
+struct cpu {
+  int id;                   /* Index in cpus[], 0 for the bootstrap CPU. */
+  uint8_t apic_id;          /* Local APIC ID. */
+  bool bsp;                 /* Is this the bootstrap processor? */
+  volatile bool online;     /* Has this CPU finished starting up? */
+  uint8_t* stack;           /* Idle thread page for an application processor. */
+  struct thread* fpu_owner; /* Thread whose state is in the FPU, if any. */
+};
+
+extern struct cpu cpus[MP_MAX_CPUS];
+extern size_t cpu_cnt;
+
+void mp_init(void);
+struct cpu* cpu_current(void);
+size_t mp_online_cnt(void);
+void mp_wake(int cpu);
+
+#endif /* threads/mp.h */
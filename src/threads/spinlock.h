@@ -0,0 +1,73 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Spin lock.
+
+   Disabling interrupts only excludes other code on the same CPU.
+   A spin lock also excludes other CPUs: a CPU that finds it held
+   busy-waits until its holder releases it.  Spin locks must only
+   be held briefly, and never across anything that can sleep.
+
+   spin_lock_irqsave() also disables interrupts on the local CPU,
+   so that an interrupt handler that takes the same lock cannot
+   deadlock against the code it interrupted. */
+struct spinlock {
+  volatile unsigned locked; /* Nonzero while held. */
+};
+
+/* Initializes spin lock LOCK as released. */
+static inline void spin_init(struct spinlock* lock) { lock->locked = 0; }
+
+/* Acquires LOCK, busy-waiting until it is free. */
+static inline void spin_lock(struct spinlock* lock) {
+  unsigned held = 1;
+
+  for (;;) {
+    /* XCHG with a memory operand is implicitly locked.  See
+       [IA32-v2b] "XCHG". */
+    asm volatile("xchgl %0, %1" : "+r"(held), "+m"(lock->locked) : : "memory");
+    if (!held)
+      return;
+    while (lock->locked)
+      asm volatile("pause");
+    held = 1;
+  }
+}
+
+/* Acquires LOCK if it is free and returns true, or returns false
+   at once if it is held. */
+static inline bool spin_trylock(struct spinlock* lock) {
+  unsigned held = 1;
+
+  asm volatile("xchgl %0, %1" : "+r"(held), "+m"(lock->locked) : : "memory");
+  return !held;
+}
+
+/* Releases LOCK, which must be held. */
+static inline void spin_unlock(struct spinlock* lock) {
+  ASSERT(lock->locked);
+  asm volatile("movl $0, %0" : "=m"(lock->locked) : : "memory");
+}
+
+/* Returns true if LOCK is held by some CPU. */
+static inline bool spin_is_locked(const struct spinlock* lock) { return lock->locked != 0; }
+
+/* Disables interrupts, acquires LOCK, and returns the previous
+   interrupt level, to be passed to spin_unlock_irqrestore(). */
+static inline enum intr_level spin_lock_irqsave(struct spinlock* lock) {
+  enum intr_level old_level = intr_disable();
+  spin_lock(lock);
+  return old_level;
+}
+
+/* Releases LOCK and restores the interrupt level OLD_LEVEL. */
+static inline void spin_unlock_irqrestore(struct spinlock* lock, enum intr_level old_level) {
+  spin_unlock(lock);
+  intr_set_level(old_level);
+}
+
+#endif /* threads/spinlock.h */
@@ -6,12 +6,11 @@
 struct switch_threads_frame {
   uint32_t edi;        /*  0: Saved %edi. */
   uint32_t esi;        /*  4: Saved %esi. */
-  char fpu[108];       /* 112: saved FPU */
-  uint32_t ebp;        /* 116: Saved %ebp. */
-  uint32_t ebx;        /* 120: Saved %ebx. */
-  void (*eip)(void);   /* 124: Return address. */
-  struct thread* cur;  /* 128: switch_threads()'s CUR argument. */
-  struct thread* next; /* 132: switch_threads()'s NEXT argument. */
+  uint32_t ebp;        /*  8: Saved %ebp. */
+  uint32_t ebx;        /* 12: Saved %ebx. */
+  void (*eip)(void);   /* 16: Return address. */
+  struct thread* cur;  /* 20: switch_threads()'s CUR argument. */
+  struct thread* next; /* 24: switch_threads()'s NEXT argument. */
 };
 
 /* Switches from CUR, which must be the running thread, to NEXT,
@@ -32,7 +31,7 @@ void switch_thunk(void);
 #endif
 
 /* Offsets used by switch.S. */
-#define SWITCH_CUR 128
-#define SWITCH_NEXT 132
+#define SWITCH_CUR 20
+#define SWITCH_NEXT 24
 
 #endif /* threads/switch.h */
@@ -4,16 +4,20 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include <threadstat.h>
+#include "devices/timer.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
+#include "threads/mp.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #ifdef USERPROG
 #include "userprog/process.h"
-#include "threads/malloc.h"  // added
 #include "filesys/filesys.h" // added
 #include "filesys/inode.h"   // added
 #endif
@@ -23,23 +27,92 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list fifo_ready_list;
+/* Ready queues for the FIFO scheduler, one per CPU, holding the
+   threads in THREAD_READY state, that is, ready to run but not
+   actually running.
+
+   A thread is queued on the CPU it last ran on, whose caches are
+   likely to still hold its working set.  A CPU whose queue is
+   empty steals a thread from the busiest queue, and every
+   REBALANCE_TICKS a CPU pulls threads from the busiest queue if
+   that queue is more than IMBALANCE threads longer than its own.
+
+   Each queue has its own lock, so that CPUs scheduling from
+   their own queues do not wait for each other.  A CPU that needs
+   two queues at once, to steal or to rebalance, takes their
+   locks in order of CPU number.  The locks are only taken with
+   interrupts off. */
+struct runqueue {
+  struct spinlock lock; /* Protects the members below. */
+  struct list ready;    /* Ready threads. */
+  size_t cnt;           /* Number of threads in READY. */
+  uint64_t migrations;  /* Threads moved here from another queue. */
+};
+
+static struct runqueue runqueues[MP_MAX_CPUS];
+static int sched_cpu_cnt = 1; /* CPUs 0 to sched_cpu_cnt - 1 run threads. */
+
+#define REBALANCE_TICKS (TIMER_FREQ / 10) /* Ticks between rebalancing. */
+#define IMBALANCE 2                       /* Queue length difference tolerated. */
+
+/* Ready queues for the strict-priority and MLFQS schedulers,
+   one FIFO per priority level, and a bitmap with bit P set
+   whenever prio_ready_lists[P] is nonempty.  The highest ready
+   priority is then the highest set bit, found without a scan. */
+#define PRIO_MAP_WORDS ((PRI_MAX + 1 + 31) / 32)
+static struct list prio_ready_lists[PRI_MAX + 1];
+static uint32_t prio_ready_map[PRIO_MAP_WORDS];
+static int prio_ready_cnt; /* Number of threads in the queues. */
+
+/* Protects the priority queues and the stride scheduler's heap
+   and virtual time below, which all CPUs share.  Only taken with
+   interrupts off. */
+static struct spinlock ready_lock;
+
+/* Ready heap for the stride scheduler: a binary min-heap of
+   ready threads ordered by pass.  It starts out in static
+   storage and is grown by thread_create() so that it can always
+   hold every thread. */
+#define FAIR_HEAP_INITIAL 64
+static struct thread* fair_heap_initial[FAIR_HEAP_INITIAL];
+static struct thread** fair_heap = fair_heap_initial;
+static size_t fair_heap_cnt;                     /* Number of threads in the heap. */
+static size_t fair_heap_cap = FAIR_HEAP_INITIAL; /* Capacity of the heap. */
+static int64_t fair_vtime;                       /* Pass of the last thread chosen. */
+
+/* A thread's stride, the amount its pass advances per tick run,
+   is STRIDE1 divided by its tickets, which are its priority plus
+   one. */
+#define STRIDE1 (1 << 16)
+
+/* Number of threads in all_list. */
+static size_t thread_cnt;
+
+/* Pages of recently exited threads, kept for reuse by
+   thread_create().  Taking a page from here skips the page
+   allocator's lock and bitmap, and since init_thread() clears
+   the struct thread header, the rest of the page need not be
+   zeroed.  Only THREAD_CACHE_PAGES are kept so that the cache
+   holds little memory that palloc_get_page() could otherwise
+   hand out.  Accessed with interrupts off. */
+#define THREAD_CACHE_PAGES 16
+static struct thread* thread_cache[THREAD_CACHE_PAGES];
+static size_t thread_cache_cnt;
+
+/* System load average for the MLFQS scheduler: the number of
+   threads ready to run, averaged over the last minute. */
+static fixed_point_t load_avg;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Idle thread. */
-static struct thread* idle_thread;
+/* Idle thread of each CPU. */
+static struct thread* idle_threads[MP_MAX_CPUS];
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread* initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
-
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame {
   void* eip;             /* Return address. */
@@ -53,19 +126,41 @@ static long long kernel_ticks; /* # of timer ticks in kernel threads. */
 static long long user_ticks;   /* # of timer ticks in user programs. */
 
 /* Scheduling. */
-#define TIME_SLICE 4          /* # of timer ticks to give each thread. */
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
+#define TIME_SLICE 4                       /* # of timer ticks to give each thread. */
+static unsigned thread_ticks[MP_MAX_CPUS]; /* # of timer ticks since last yield, per CPU. */
 
 static void init_thread(struct thread*, const char* name, int priority);
 static bool is_thread(struct thread*) UNUSED;
 static void* alloc_frame(struct thread*, size_t size);
-static void schedule(void);
+static void schedule(bool preempted);
+static void yield(bool preempted);
 static void thread_enqueue(struct thread* t);
+static bool is_idle_thread(const struct thread* t);
+static bool cpu_is_idle(int cpu);
+static void wake_idle_cpu(void);
+static struct spinlock* sched_lock(int cpu);
+static struct runqueue* busiest_runqueue(int cpu);
+static bool runqueue_trylock_other(struct runqueue* rq, struct runqueue* other);
+static void runqueue_rebalance(int cpu);
+static size_t runqueue_steal(int cpu, struct runqueue* from, size_t max);
+static bool prio_queues_active(void);
+static int prio_highest_ready(void);
+static void prio_insert(struct thread* t);
+static void prio_remove(struct thread* t);
+static void mlfqs_tick(struct thread* cur, int64_t tick);
+static bool fair_heap_reserve(void);
+static void fair_push(struct thread* t);
+static struct thread* fair_pop(void);
+static void mlfqs_update_priority(struct thread* t);
+static void thread_set_effective_priority(struct thread* t, int priority);
 static tid_t allocate_tid(void);
+static struct thread* thread_page_alloc(void);
+static void thread_page_free(struct thread* t);
 void thread_switch_tail(struct thread* prev);
 
 static void kernel_thread(thread_func*, void* aux);
 static void idle(void* aux UNUSED);
+static void idle_loop(void) NO_RETURN;
 static struct thread* running_thread(void);
 
 static struct thread* next_thread_to_run(void);
@@ -98,7 +193,7 @@ scheduler_func* scheduler_jump_table[8] = {thread_schedule_fifo,     thread_sche
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
 
-   Also initializes the run queue and the tid lock.
+   Also initializes the run queues.
 
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
@@ -107,10 +202,17 @@ scheduler_func* scheduler_jump_table[8] = {thread_schedule_fifo,     thread_sche
    It is not safe to call thread_current() until this function
    finishes. */
 void thread_init(void) {
+  int i;
+
   ASSERT(intr_get_level() == INTR_OFF);
 
-  lock_init(&tid_lock);
-  list_init(&fifo_ready_list);
+  for (i = 0; i < MP_MAX_CPUS; i++) {
+    spin_init(&runqueues[i].lock);
+    list_init(&runqueues[i].ready);
+  }
+  spin_init(&ready_lock);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init(&prio_ready_lists[i]);
   list_init(&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -131,17 +233,24 @@ void thread_start(void) {
   /* Start preemptive thread scheduling. */
   intr_enable();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize idle_threads[]. */
   sema_down(&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
-void thread_tick(void) {
+/* Called by the timer interrupt handler at each timer tick,
+   TICK being the number of the tick accounted for.  In tickless
+   mode the handler may account for several ticks in one
+   interrupt, calling this once for each, so TICK need not match
+   timer_ticks().  The application processors count their own
+   ticks, from their local APIC timers, so TICK is only
+   comparable between ticks of one CPU.  Runs in an external
+   interrupt context. */
+void thread_tick(int64_t tick) {
   struct thread* t = thread_current();
+  int cpu = thread_cpu();
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (is_idle_thread(t))
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pcb != NULL)
@@ -149,12 +258,104 @@ void thread_tick(void) {
 #endif
   else
     kernel_ticks++;
+  t->run_ticks++;
+
+  if (active_sched_policy == SCHED_FIFO && sched_cpu_cnt > 1 && tick % REBALANCE_TICKS == 0)
+    runqueue_rebalance(cpu);
+  else if (active_sched_policy == SCHED_MLFQS)
+    mlfqs_tick(t, tick);
+  else if (active_sched_policy == SCHED_FAIR && !is_idle_thread(t))
+    t->pass += STRIDE1 / (t->priority + 1);
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++thread_ticks[cpu] >= TIME_SLICE)
     intr_yield_on_return();
 }
 
+/* Updates the MLFQS statistics for timer tick TICK, during
+   which CUR was running.  Only CUR's recent_cpu changes from tick to
+   tick, so only CUR's priority is recomputed every fourth tick;
+   every thread is visited just once a second, when load_avg and
+   every recent_cpu decay.  That is done by CPU 0, whose ticks
+   are the timer's. */
+static void mlfqs_tick(struct thread* cur, int64_t tick) {
+  if (!is_idle_thread(cur))
+    cur->recent_cpu = fix_add(cur->recent_cpu, fix_int(1));
+
+  if (tick % TIMER_FREQ == 0 && thread_cpu() == 0) {
+    int ready = prio_ready_cnt;
+    fixed_point_t decay;
+    struct list_elem* e;
+
+    /* Running threads count as ready, on every CPU. */
+    for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
+      struct thread* t = list_entry(e, struct thread, allelem);
+      if (t->status == THREAD_RUNNING && !is_idle_thread(t))
+        ready++;
+    }
+
+    load_avg = fix_add(fix_mul(fix_frac(59, 60), load_avg), fix_scale(fix_frac(1, 60), ready));
+    decay = fix_div(fix_scale(load_avg, 2), fix_add(fix_scale(load_avg, 2), fix_int(1)));
+    for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
+      struct thread* t = list_entry(e, struct thread, allelem);
+      if (!is_idle_thread(t)) {
+        t->recent_cpu = fix_add(fix_mul(decay, t->recent_cpu), fix_int(t->nice));
+        mlfqs_update_priority(t);
+      }
+    }
+  } else if (tick % TIME_SLICE == 0 && !is_idle_thread(cur))
+    mlfqs_update_priority(cur);
+
+  thread_preempt();
+}
+
+/* Recomputes T's MLFQS priority from its recent_cpu and nice
+   values.  Interrupts must be off. */
+static void mlfqs_update_priority(struct thread* t) {
+  fixed_point_t p = fix_sub(fix_int(PRI_MAX - t->nice * 2), fix_unscale(t->recent_cpu, 4));
+  int priority = fix_trunc(p);
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  if (priority != t->priority)
+    thread_set_effective_priority(t, priority);
+}
+
+/* Fills BUF with the CPU accounting of up to MAX threads and
+   returns the number filled in. */
+int thread_get_stats(struct threadstat* buf, int max) {
+  enum intr_level old_level = intr_disable();
+  struct list_elem* e;
+  int cnt = 0;
+
+  for (e = list_begin(&all_list); e != list_end(&all_list) && cnt < max; e = list_next(e)) {
+    struct thread* t = list_entry(e, struct thread, allelem);
+    struct threadstat* ts = &buf[cnt++];
+
+    ts->tid = t->tid;
+    ts->pid = 0;
+#ifdef USERPROG
+    if (t->pcb != NULL && t->pcb->main_thread != NULL)
+      ts->pid = t->pcb->main_thread->tid;
+#endif
+    strlcpy(ts->name, t->name, sizeof ts->name);
+    ts->priority = t->priority;
+    ts->state = t->status == THREAD_RUNNING ? THREADSTAT_RUNNING
+                : t->status == THREAD_READY ? THREADSTAT_READY
+                                            : THREADSTAT_BLOCKED;
+    ts->run_ticks = t->run_ticks;
+    ts->voluntary = t->voluntary_cnt;
+    ts->involuntary = t->involuntary_cnt;
+    ts->wait_cnt = t->wait_cnt;
+    ts->wait_total_ns = timer_cycles_to_ns(t->wait_total);
+    ts->wait_max_ns = timer_cycles_to_ns(t->wait_max);
+  }
+  intr_set_level(old_level);
+  return cnt;
+}
+
 /* Prints thread statistics. */
 void thread_print_stats(void) {
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n", idle_ticks, kernel_ticks,
@@ -173,11 +374,12 @@ void thread_print_stats(void) {
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   Under the strict-priority scheduler, a new thread with a
+   higher PRIORITY than the caller runs immediately.  The MLFQS
+   scheduler ignores PRIORITY: the new thread inherits the
+   caller's nice and recent_cpu values and its priority is
+   computed from them. */
 tid_t thread_create(const char* name, int priority, thread_func* function, void* aux) {
-  char temp[108];
   struct thread* t;
   struct kernel_thread_frame* kf;
   struct switch_entry_frame* ef;
@@ -187,13 +389,27 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
   ASSERT(function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = thread_page_alloc();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread(t, name, priority);
+  if (active_sched_policy == SCHED_FAIR && !fair_heap_reserve()) {
+    enum intr_level old_level = intr_disable();
+    list_remove(&t->allelem);
+    thread_cnt--;
+    intr_set_level(old_level);
+    thread_page_free(t);
+    return TID_ERROR;
+  }
   tid = t->tid = allocate_tid();
+  t->cpu = thread_current()->cpu;
+  if (active_sched_policy == SCHED_MLFQS && function != idle) {
+    t->nice = thread_current()->nice;
+    t->recent_cpu = thread_current()->recent_cpu;
+    mlfqs_update_priority(t);
+  }
 
   // added for project 3: subdirectories
 #ifdef FILESYS
@@ -212,16 +428,10 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
 
   /* Stack frame for switch_threads(). */
   sf = alloc_frame(t, sizeof *sf);
-  asm volatile("fsave %0" : "=g"(temp));
-  asm volatile("finit");
-  asm volatile("fsave %0" : "=g"(sf->fpu));
   sf->eip = switch_entry;
   sf->ebp = 0;
 
-  asm volatile("frstor %0" : "=g"(temp));
-
   /* Add to run queue. */
-
   thread_unblock(t);
 
   return tid;
@@ -237,42 +447,124 @@ void thread_block(void) {
   ASSERT(!intr_context());
   ASSERT(intr_get_level() == INTR_OFF);
 
+  spin_lock(sched_lock(thread_cpu()));
   thread_current()->status = THREAD_BLOCKED;
-  schedule();
+  schedule(false);
 }
 
 /* Places a thread on the ready structure appropriate for the
-   current active scheduling policy.
+   current active scheduling policy, and wakes an idle CPU that
+   can run it.
    
-   This function must be called with interrupts turned off. */
+   This function must be called with interrupts turned off and
+   the scheduler lock for T's CPU held. */
 static void thread_enqueue(struct thread* t) {
   ASSERT(intr_get_level() == INTR_OFF);
   ASSERT(is_thread(t));
 
-  if (active_sched_policy == SCHED_FIFO)
-    list_push_back(&fifo_ready_list, &t->elem);
-  else
+  t->ready_since = timer_cycles();
+  if (active_sched_policy == SCHED_FIFO) {
+    struct runqueue* rq = &runqueues[t->cpu];
+    list_push_back(&rq->ready, &t->elem);
+    rq->cnt++;
+
+    /* Wake T's CPU if it is idle.  If T has to wait behind
+       another thread there instead, wake an idle CPU to steal
+       one. */
+    if (cpu_is_idle(t->cpu))
+      mp_wake(t->cpu);
+    else if (rq->cnt > 1)
+      wake_idle_cpu();
+    return;
+  }
+
+  if (prio_queues_active())
+    prio_insert(t);
+  else if (active_sched_policy == SCHED_FAIR) {
+    /* A thread that slept must not bank the time it was away. */
+    if (t->pass < fair_vtime)
+      t->pass = fair_vtime;
+    fair_push(t);
+  } else
     PANIC("Unimplemented scheduling policy value: %d", active_sched_policy);
+
+  /* Any CPU may run T from the shared queues. */
+  wake_idle_cpu();
+}
+
+/* Wakes one idle CPU other than the running one, if there is
+   any.  Interrupts must be off. */
+static void wake_idle_cpu(void) {
+  int cpu;
+
+  for (cpu = 0; cpu < sched_cpu_cnt; cpu++)
+    if (cpu_is_idle(cpu)) {
+      mp_wake(cpu);
+      break;
+    }
+}
+
+/* Returns true if T is the idle thread of the CPU it belongs to.
+   Idle threads never move between CPUs. */
+static bool is_idle_thread(const struct thread* t) { return t == idle_threads[t->cpu]; }
+
+/* Returns true if CPU is a CPU other than the running one that
+   is waiting idly for work, and so will not look at the ready
+   queues again until it is interrupted.  Interrupts must be
+   off. */
+static bool cpu_is_idle(int cpu) {
+  struct thread* idle = idle_threads[cpu];
+  return cpu != thread_cpu() && idle != NULL && idle->status == THREAD_RUNNING;
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
-   it may expect that it can atomically unblock a thread and
-   update other data. */
+   If T outranks the running thread, the running thread is
+   preempted, but only once interrupts are back on: if the
+   caller had disabled interrupts itself, it may expect that it
+   can atomically unblock a thread and update other data, and
+   should call thread_preempt() when it is done. */
 void thread_unblock(struct thread* t) {
   enum intr_level old_level;
+  struct spinlock* lock;
 
   ASSERT(is_thread(t));
 
   old_level = intr_disable();
+  lock = sched_lock(t->cpu);
+  spin_lock(lock);
   ASSERT(t->status == THREAD_BLOCKED);
   thread_enqueue(t);
   t->status = THREAD_READY;
+  spin_unlock(lock);
   intr_set_level(old_level);
+  thread_preempt();
+}
+
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread under the strict-priority or MLFQS
+   scheduler.  In an interrupt handler the yield happens on
+   return from the interrupt; with interrupts off it does not
+   happen at all. */
+void thread_preempt(void) {
+  enum intr_level old_level;
+  bool outranked;
+
+  if (!prio_queues_active())
+    return;
+
+  old_level = spin_lock_irqsave(&ready_lock);
+  outranked = prio_highest_ready() > thread_current()->priority;
+  spin_unlock_irqrestore(&ready_lock, old_level);
+
+  if (!outranked)
+    return;
+  if (intr_context())
+    intr_yield_on_return();
+  else if (old_level == INTR_ON)
+    thread_yield();
 }
 
 /* Returns the name of the running thread. */
@@ -308,24 +600,37 @@ void thread_exit(void) {
      when it calls thread_switch_tail(). */
   intr_disable();
   list_remove(&thread_current()->allelem);
+  thread_cnt--;
+  spin_lock(sched_lock(thread_cpu()));
   thread_current()->status = THREAD_DYING;
-  schedule();
+  schedule(false);
   NOT_REACHED();
 }
 
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
-void thread_yield(void) {
+void thread_yield(void) { yield(false); }
+
+/* Yields the CPU because an interrupt handler asked to preempt
+   the running thread with intr_yield_on_return().  Called only
+   by the interrupt handler on its way out, and counted as an
+   involuntary context switch. */
+void thread_yield_preempted(void) { yield(true); }
+
+/* Yields the CPU, which is PREEMPTED if the running thread did
+   not ask to give it up. */
+static void yield(bool preempted) {
   struct thread* cur = thread_current();
   enum intr_level old_level;
 
   ASSERT(!intr_context());
 
   old_level = intr_disable();
-  if (cur != idle_thread)
+  spin_lock(sched_lock(cur->cpu));
+  if (!is_idle_thread(cur))
     thread_enqueue(cur);
   cur->status = THREAD_READY;
-  schedule();
+  schedule(preempted);
   intr_set_level(old_level);
 }
 
@@ -343,66 +648,202 @@ void thread_foreach(thread_action_func* func, void* aux) {
 }
 
 /* Sets the current thread's priority to NEW_PRIORITY. */
-void thread_set_priority(int new_priority) { thread_current()->priority = new_priority; }
+void thread_set_priority(int new_priority) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  if (active_sched_policy == SCHED_MLFQS)
+    return;
+
+  old_level = intr_disable();
+  cur->base_priority = new_priority;
+  if (active_sched_policy == SCHED_PRIO)
+    thread_refresh_priority(cur);
+  else
+    cur->priority = new_priority;
+  intr_set_level(old_level);
+  thread_preempt();
+}
+
+/* Number of lock holders a priority donation passes through,
+   which bounds the time spent in lock_acquire() on long or
+   cyclic chains. */
+#define DONATION_DEPTH 8
+
+/* Donates T's priority to the holder of the lock T is waiting
+   on, and onward through the chain of locks the holders are
+   themselves waiting on, up to DONATION_DEPTH holders.  Does
+   nothing unless the strict-priority scheduler is active.
+   Interrupts must be off. */
+void thread_donate_priority(struct thread* t) {
+  int depth;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (active_sched_policy != SCHED_PRIO)
+    return;
+  for (depth = 0; depth < DONATION_DEPTH && t->waiting_lock != NULL; depth++) {
+    struct thread* holder = t->waiting_lock->holder;
+    if (holder == NULL || holder->priority >= t->priority)
+      break;
+    thread_set_effective_priority(holder, t->priority);
+    t = holder;
+  }
+}
+
+/* Recomputes T's priority as the higher of its base priority
+   and the priorities of the threads waiting on locks it holds.
+   Called when T acquires or releases a lock, so that donations
+   through a released lock are given back.  Does nothing unless
+   the strict-priority scheduler is active.  Interrupts must be
+   off. */
+void thread_refresh_priority(struct thread* t) {
+  struct list_elem* l;
+  int priority = t->base_priority;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (active_sched_policy != SCHED_PRIO)
+    return;
+  for (l = list_begin(&t->held_locks); l != list_end(&t->held_locks); l = list_next(l)) {
+    struct list* waiters = &list_entry(l, struct lock, elem)->semaphore.waiters;
+    struct list_elem* w;
+
+    for (w = list_begin(waiters); w != list_end(waiters); w = list_next(w)) {
+      struct thread* waiter = list_entry(w, struct thread, elem);
+      if (waiter->priority > priority)
+        priority = waiter->priority;
+    }
+  }
+  thread_set_effective_priority(t, priority);
+}
+
+/* Changes T's priority to PRIORITY, moving it to the matching
+   ready queue if it is ready to run under a scheduler that keeps
+   per-priority queues.  T stays ready throughout, so the time it
+   has already waited keeps counting.  Interrupts must be off. */
+static void thread_set_effective_priority(struct thread* t, int priority) {
+  if (!prio_queues_active()) {
+    t->priority = priority;
+    return;
+  }
+
+  spin_lock(&ready_lock);
+  if (t->status == THREAD_READY && !is_idle_thread(t)) {
+    prio_remove(t);
+    t->priority = priority;
+    prio_insert(t);
+  } else
+    t->priority = priority;
+  spin_unlock(&ready_lock);
+}
 
 /* Returns the current thread's priority. */
 int thread_get_priority(void) { return thread_current()->priority; }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED) { /* Not yet implemented. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority, yielding if it no longer has the highest. */
+void thread_set_nice(int nice) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable();
+  cur->nice = nice;
+  if (active_sched_policy == SCHED_MLFQS)
+    mlfqs_update_priority(cur);
+  intr_set_level(old_level);
+  thread_preempt();
 }
 
 /* Returns the current thread's nice value. */
-int thread_get_nice(void) {
-  /* Not yet implemented. */
-  return 0;
-}
+int thread_get_nice(void) { return thread_current()->nice; }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void) {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable();
+  int load = fix_round(fix_scale(load_avg, 100));
+  intr_set_level(old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void) {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable();
+  int recent = fix_round(fix_scale(thread_current()->recent_cpu, 100));
+  intr_set_level(old_level);
+  return recent;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
-   The idle thread is initially put on the ready list by
-   thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   The bootstrap CPU's idle thread is initially put on the ready
+   list by thread_start().  It will be scheduled once initially,
+   at which point it initializes idle_threads[0], "up"s the
+   semaphore passed to it to enable thread_start() to continue,
+   and immediately blocks.  After that, the idle thread never
+   appears in the ready list.  It is returned by
+   next_thread_to_run() as a special case when the ready list is
+   empty.  Each application processor turns the code that starts
+   it into its own idle thread with thread_init_ap(). */
 static void idle(void* idle_started_ UNUSED) {
   struct semaphore* idle_started = idle_started_;
-  idle_thread = thread_current();
+  idle_threads[thread_cpu()] = thread_current();
   sema_up(idle_started);
+  idle_loop();
+}
+
+/* Body of every CPU's idle thread. */
+static void idle_loop(void) {
+  /* Only the bootstrap CPU gets interrupts from the timer, whose
+     tickless mode it alone controls. */
+  bool timer_cpu = thread_cpu() == 0;
 
   for (;;) {
     /* Let someone else run. */
     intr_disable();
+    if (timer_cpu)
+      timer_idle_exit();
     thread_block();
+    if (timer_cpu)
+      timer_idle_enter();
 
-    /* Re-enable interrupts and wait for the next one.
+    /* Re-enable interrupts and wait for the next one. */
+    intr_wait();
+  }
+}
 
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
+/* Turns the code running on application processor CPU, on the
+   page that mp_init() allocated for its stack, into CPU's idle
+   thread.  Interrupts must be off. */
+void thread_init_ap(int cpu) {
+  struct thread* t = running_thread();
 
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-    asm volatile("sti; hlt" : : : "memory");
-  }
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(cpu > 0 && cpu < MP_MAX_CPUS);
+
+  init_thread(t, "idle", PRI_MIN);
+  t->status = THREAD_RUNNING;
+  t->tid = allocate_tid();
+  t->cpu = cpu;
+  idle_threads[cpu] = t;
+
+  /* From now on CPU's queue takes part in stealing and
+     rebalancing.  APs start in order, so the CPUs that run
+     threads are numbered consecutively. */
+  if (cpu >= sched_cpu_cnt)
+    sched_cpu_cnt = cpu + 1;
+}
+
+/* Runs the application processor's idle thread, which schedules
+   other threads whenever there are any.  Interrupts must be
+   off. */
+void thread_start_ap(void) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(is_idle_thread(thread_current()));
+
+  idle_loop();
 }
 
 /* Function used as the basis for a kernel thread. */
@@ -444,7 +885,8 @@ static void init_thread(struct thread* t, const char* name, int priority) {
   t->status = THREAD_BLOCKED;
   strlcpy(t->name, name, sizeof t->name);
   t->stack = (uint8_t*)t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init(&t->held_locks);
   t->pcb = NULL;
   t->magic = THREAD_MAGIC;
 #ifdef USERPROG               // added
@@ -454,9 +896,45 @@ static void init_thread(struct thread* t, const char* name, int priority) {
 
   old_level = intr_disable();
   list_push_back(&all_list, &t->allelem);
+  thread_cnt++;
   intr_set_level(old_level);
 }
 
+/* Returns a page for a new thread, preferably one from the
+   thread cache, or a null pointer if no page is available.  The
+   page's contents are undefined except that a page that did not
+   come from the cache is zeroed. */
+static struct thread* thread_page_alloc(void) {
+  struct thread* t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable();
+  if (thread_cache_cnt > 0)
+    t = thread_cache[--thread_cache_cnt];
+  intr_set_level(old_level);
+
+  return t != NULL ? t : palloc_get_page(PAL_ZERO);
+}
+
+/* Releases T's page to the thread cache, or to the page
+   allocator if the cache is full. */
+static void thread_page_free(struct thread* t) {
+  enum intr_level old_level;
+
+  /* Catch stale pointers to the dead thread. */
+  t->magic = 0;
+
+  old_level = intr_disable();
+  if (thread_cache_cnt < THREAD_CACHE_PAGES) {
+    thread_cache[thread_cache_cnt++] = t;
+    t = NULL;
+  }
+  intr_set_level(old_level);
+
+  if (t != NULL)
+    palloc_free_page(t);
+}
+
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
    returns a pointer to the frame's base. */
 static void* alloc_frame(struct thread* t, size_t size) {
@@ -468,29 +946,281 @@ static void* alloc_frame(struct thread* t, size_t size) {
   return t->stack;
 }
 
-/* First-in first-out scheduler */
+/* First-in first-out scheduler.  Runs the thread at the front of
+   this CPU's queue, stealing one from the busiest CPU if there is
+   none. */
 static struct thread* thread_schedule_fifo(void) {
-  if (!list_empty(&fifo_ready_list))
-    return list_entry(list_pop_front(&fifo_ready_list), struct thread, elem);
-  else
-    return idle_thread;
+  int cpu = thread_cpu();
+  struct runqueue* rq = &runqueues[cpu];
+
+  if (rq->cnt == 0) {
+    struct runqueue* busiest = busiest_runqueue(cpu);
+    if (busiest != NULL && runqueue_trylock_other(rq, busiest)) {
+      runqueue_steal(cpu, busiest, 1);
+      spin_unlock(&busiest->lock);
+    }
+  }
+
+  if (list_empty(&rq->ready))
+    return idle_threads[cpu];
+  rq->cnt--;
+  return list_entry(list_pop_front(&rq->ready), struct thread, elem);
+}
+
+/* Returns the number of the CPU running the current thread, an
+   index into cpus[] (see threads/mp.h).  Unless interrupts are
+   off, the thread may be moved to another CPU at any time. */
+int thread_cpu(void) { return running_thread()->cpu; }
+
+/* Returns the lock that protects the ready threads of CPU: its
+   own queue's under the FIFO scheduler, and the shared queues'
+   under the others.
+
+   The running CPU's scheduler lock is held from the moment the
+   running thread decides to give up the CPU until the thread
+   switched to takes over in thread_switch_tail().  Until then,
+   no other CPU can take the old thread from a ready queue while
+   this CPU is still running on its stack, nor wake it before it
+   has finished blocking. */
+static struct spinlock* sched_lock(int cpu) {
+  return active_sched_policy == SCHED_FIFO ? &runqueues[cpu].lock : &ready_lock;
+}
+
+/* Returns the longest ready queue of a CPU other than CPU, or a
+   null pointer if all of them are empty.  The queues' lengths
+   are read without their locks, so the answer is only a hint,
+   to be checked with the locks held.  Interrupts must be off. */
+static struct runqueue* busiest_runqueue(int cpu) {
+  struct runqueue* busiest = NULL;
+  int i;
+
+  for (i = 0; i < sched_cpu_cnt; i++)
+    if (i != cpu && runqueues[i].cnt > 0 && (busiest == NULL || runqueues[i].cnt > busiest->cnt))
+      busiest = &runqueues[i];
+  return busiest;
+}
+
+/* Acquires the lock of ready queue OTHER while that of RQ is
+   held, and returns true.  Waiting for OTHER's lock is only safe
+   if OTHER comes after RQ in the lock order; otherwise, if
+   another CPU holds it, returns false at once instead. */
+static bool runqueue_trylock_other(struct runqueue* rq, struct runqueue* other) {
+  if (other > rq) {
+    spin_lock(&other->lock);
+    return true;
+  }
+  return spin_trylock(&other->lock);
+}
+
+/* Pulls threads into CPU's ready queue from the busiest other
+   queue, if that one is more than IMBALANCE threads longer, so
+   that their lengths even out.  Interrupts must be off. */
+static void runqueue_rebalance(int cpu) {
+  struct runqueue* rq = &runqueues[cpu];
+  struct runqueue* busiest = busiest_runqueue(cpu);
+  struct runqueue* first;
+  struct runqueue* second;
+
+  if (busiest == NULL)
+    return;
+
+  /* Lock both queues in order of CPU number. */
+  first = rq < busiest ? rq : busiest;
+  second = rq < busiest ? busiest : rq;
+  spin_lock(&first->lock);
+  spin_lock(&second->lock);
+  if (busiest->cnt > rq->cnt + IMBALANCE)
+    runqueue_steal(cpu, busiest, (busiest->cnt - rq->cnt) / 2);
+  spin_unlock(&second->lock);
+  spin_unlock(&first->lock);
+}
+
+/* Moves up to MAX threads from the back of ready queue FROM,
+   where they have waited the least and are least likely to be
+   next to run there, to the queue of CPU.  Returns the number of
+   threads moved.  Interrupts must be off and both queues' locks
+   held. */
+static size_t runqueue_steal(int cpu, struct runqueue* from, size_t max) {
+  struct runqueue* to = &runqueues[cpu];
+  size_t moved = 0;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(from != to);
+  ASSERT(spin_is_locked(&from->lock) && spin_is_locked(&to->lock));
+
+  while (moved < max && !list_empty(&from->ready)) {
+    struct thread* t = list_entry(list_pop_back(&from->ready), struct thread, elem);
+    from->cnt--;
+    t->cpu = cpu;
+    list_push_back(&to->ready, &t->elem);
+    to->cnt++;
+    moved++;
+  }
+
+  to->migrations += moved;
+  return moved;
 }
 
-/* Strict priority scheduler */
+/* Returns the number of times a thread has moved from one CPU's
+   ready queue to another's. */
+uint64_t thread_migration_cnt(void) {
+  uint64_t cnt = 0;
+  int cpu;
+
+  for (cpu = 0; cpu < MP_MAX_CPUS; cpu++) {
+    struct runqueue* rq = &runqueues[cpu];
+    enum intr_level old_level = spin_lock_irqsave(&rq->lock);
+    cnt += rq->migrations;
+    spin_unlock_irqrestore(&rq->lock, old_level);
+  }
+  return cnt;
+}
+
+/* Returns true if the active scheduler runs threads from the
+   per-priority ready queues. */
+static bool prio_queues_active(void) {
+  return active_sched_policy == SCHED_PRIO || active_sched_policy == SCHED_MLFQS;
+}
+
+/* Appends ready thread T to the queue for its priority.
+   Interrupts must be off. */
+static void prio_insert(struct thread* t) {
+  list_push_back(&prio_ready_lists[t->priority], &t->elem);
+  prio_ready_map[t->priority / 32] |= 1u << (t->priority % 32);
+  prio_ready_cnt++;
+}
+
+/* Removes ready thread T from its priority queue.  Interrupts
+   must be off. */
+static void prio_remove(struct thread* t) {
+  list_remove(&t->elem);
+  if (list_empty(&prio_ready_lists[t->priority]))
+    prio_ready_map[t->priority / 32] &= ~(1u << (t->priority % 32));
+  prio_ready_cnt--;
+}
+
+/* Returns the priority of the highest-priority ready thread, or
+   -1 if no thread is ready.  Interrupts must be off. */
+static int prio_highest_ready(void) {
+  int w;
+
+  for (w = PRIO_MAP_WORDS - 1; w >= 0; w--)
+    if (prio_ready_map[w] != 0)
+      return w * 32 + 31 - __builtin_clz(prio_ready_map[w]);
+  return -1;
+}
+
+/* Strict priority scheduler.  Runs the thread at the front of
+   the highest nonempty priority queue, so threads of equal
+   priority take turns. */
 static struct thread* thread_schedule_prio(void) {
-  PANIC("Unimplemented scheduler policy: \"-sched=prio\"");
+  int pri = prio_highest_ready();
+  struct thread* t;
+
+  if (pri < 0)
+    return idle_threads[thread_cpu()];
+  t = list_entry(list_front(&prio_ready_lists[pri]), struct thread, elem);
+  prio_remove(t);
+  return t;
 }
 
-/* Fair priority scheduler */
-static struct thread* thread_schedule_fair(void) {
-  PANIC("Unimplemented scheduler policy: \"-sched=fair\"");
+/* Makes sure the stride scheduler's heap can hold every thread
+   in all_list, including any that other threads are creating at
+   the same time.  Returns false if memory for a larger heap is
+   unavailable. */
+static bool fair_heap_reserve(void) {
+  for (;;) {
+    struct thread** new_heap;
+    struct thread** old_heap;
+    enum intr_level old_level;
+    size_t cnt, cap, new_cap;
+
+    /* thread_cnt is protected by turning interrupts off, which
+       taking ready_lock also does. */
+    old_level = spin_lock_irqsave(&ready_lock);
+    cnt = thread_cnt;
+    cap = fair_heap_cap;
+    spin_unlock_irqrestore(&ready_lock, old_level);
+    if (cnt <= cap)
+      return true;
+
+    for (new_cap = cap * 2; new_cap < cnt; new_cap *= 2)
+      continue;
+    new_heap = malloc(new_cap * sizeof *new_heap);
+    if (new_heap == NULL)
+      return false;
+
+    /* If another thread grew the heap while we were allocating,
+       discard our copy and check again. */
+    old_level = spin_lock_irqsave(&ready_lock);
+    if (fair_heap_cap == cap) {
+      memcpy(new_heap, fair_heap, fair_heap_cnt * sizeof *fair_heap);
+      old_heap = fair_heap;
+      fair_heap = new_heap;
+      fair_heap_cap = new_cap;
+    } else
+      old_heap = new_heap;
+    spin_unlock_irqrestore(&ready_lock, old_level);
+
+    if (old_heap != fair_heap_initial)
+      free(old_heap);
+  }
+}
+
+/* Adds T to the stride scheduler's heap.  Interrupts must be
+   off. */
+static void fair_push(struct thread* t) {
+  size_t i = fair_heap_cnt++;
+
+  ASSERT(fair_heap_cnt <= fair_heap_cap);
+
+  for (; i > 0 && t->pass < fair_heap[(i - 1) / 2]->pass; i = (i - 1) / 2)
+    fair_heap[i] = fair_heap[(i - 1) / 2];
+  fair_heap[i] = t;
+}
+
+/* Removes and returns the thread with the least pass from the
+   stride scheduler's heap, which must not be empty.  Interrupts
+   must be off. */
+static struct thread* fair_pop(void) {
+  struct thread* top = fair_heap[0];
+  struct thread* last = fair_heap[--fair_heap_cnt];
+  size_t i = 0;
+
+  for (;;) {
+    size_t c = 2 * i + 1;
+    if (c >= fair_heap_cnt)
+      break;
+    if (c + 1 < fair_heap_cnt && fair_heap[c + 1]->pass < fair_heap[c]->pass)
+      c++;
+    if (last->pass <= fair_heap[c]->pass)
+      break;
+    fair_heap[i] = fair_heap[c];
+    i = c;
+  }
+  fair_heap[i] = last;
+  return top;
 }
 
-/* Multi-level feedback queue scheduler */
-static struct thread* thread_schedule_mlfqs(void) {
-  PANIC("Unimplemented scheduler policy: \"-sched=mlfqs\"");
+/* Stride scheduler.  Runs the ready thread that has received the
+   least CPU time relative to its tickets, so that over time each
+   thread's share of the CPU is proportional to its priority plus
+   one. */
+static struct thread* thread_schedule_fair(void) {
+  struct thread* t;
+
+  if (fair_heap_cnt == 0)
+    return idle_threads[thread_cpu()];
+  t = fair_pop();
+  fair_vtime = t->pass;
+  return t;
 }
 
+/* Multi-level feedback queue scheduler.  Priorities are
+   maintained by thread_tick(); picking the next thread is the
+   same as for the strict priority scheduler. */
+static struct thread* thread_schedule_mlfqs(void) { return thread_schedule_prio(); }
+
 /* Not an actual scheduling policy — placeholder for empty
  * slots in the scheduler jump table. */
 static struct thread* thread_schedule_reserved(void) {
@@ -501,7 +1231,7 @@ static struct thread* thread_schedule_reserved(void) {
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
    will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   the running CPU's idle thread. */
 static struct thread* next_thread_to_run(void) {
   return (scheduler_jump_table[active_sched_policy])();
 }
@@ -510,8 +1240,9 @@ static struct thread* next_thread_to_run(void) {
    tables, and, if the previous thread is dying, destroying it.
 
    At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.  This function is normally invoked by
+   PREV, the new thread is already running, interrupts are still
+   disabled, and the CPU's scheduler lock is still held, but not
+   the interrupt lock.  This function is normally invoked by
    thread_switch() as its final action before returning, but
    the first time a thread is scheduled it is called by
    switch_entry() (see switch.S).
@@ -524,6 +1255,7 @@ static struct thread* next_thread_to_run(void) {
    is complete. */
 void thread_switch_tail(struct thread* prev) {
   struct thread* cur = running_thread();
+  bool prev_dying = prev != NULL && prev->status == THREAD_DYING;
 
   ASSERT(intr_get_level() == INTR_OFF);
 
@@ -531,7 +1263,27 @@ void thread_switch_tail(struct thread* prev) {
   cur->status = THREAD_RUNNING;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  thread_ticks[cur->cpu] = 0;
+
+  /* Account for the time spent waiting to run. */
+  if (cur->ready_since != 0) {
+    uint64_t wait = timer_cycles() - cur->ready_since;
+    cur->ready_since = 0;
+    cur->wait_cnt++;
+    cur->wait_total += wait;
+    if (wait > cur->wait_max)
+      cur->wait_max = wait;
+  }
+
+  /* Let the new thread use the FPU only if its state is loaded.
+     PREV's state must be saved before another CPU can run it. */
+  fpu_switch(prev, cur);
+
+  /* The switch is over, so other CPUs may now take PREV.  Take
+     back the interrupt lock that schedule() dropped, which the
+     code returned to expects to hold. */
+  spin_unlock(sched_lock(cur->cpu));
+  intr_relock();
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -543,41 +1295,62 @@ void thread_switch_tail(struct thread* prev) {
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
      palloc().) */
-  if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) {
+  if (prev_dying && prev != initial_thread) {
     ASSERT(prev != cur);
-    palloc_free_page(prev);
+    fpu_exit(prev);
+    thread_page_free(prev);
   }
 }
 
-/* Schedules a new thread.  At entry, interrupts must be off and
-   the running process's state must have been changed from
+/* Schedules a new thread.  At entry, interrupts must be off, the
+   running CPU's scheduler lock (see sched_lock()) must be held,
+   and the running process's state must have been changed from
    running to some other state.  This function finds another
-   thread to run and switches to it.
+   thread to run and switches to it, which releases the lock.
+   Picking and switching need only the scheduler lock, so the
+   interrupt lock is dropped meanwhile, letting other CPUs go on
+   with their own work.
+
+   PREEMPTED is true if the running thread is being switched
+   away from only because an interrupt handler preempted it.
 
    It's not safe to call printf() until thread_switch_tail()
    has completed. */
-static void schedule(void) {
+static void schedule(bool preempted) {
   struct thread* cur = running_thread();
-  struct thread* next = next_thread_to_run();
+  struct thread* next;
   struct thread* prev = NULL;
 
   ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(spin_is_locked(sched_lock(cur->cpu)));
   ASSERT(cur->status != THREAD_RUNNING);
+
+  intr_unlock();
+  next = next_thread_to_run();
   ASSERT(is_thread(next));
 
-  if (cur != next)
+  if (cur != next) {
+    /* A thread from the shared ready queues of the policies other
+       than FIFO may have last run on another CPU. */
+    next->cpu = cur->cpu;
+    if (preempted)
+      cur->involuntary_cnt++;
+    else if (cur->status != THREAD_DYING)
+      cur->voluntary_cnt++;
     prev = switch_threads(cur, next);
+  }
   thread_switch_tail(prev);
 }
 
 /* Returns a tid to use for a new thread. */
 static tid_t allocate_tid(void) {
   static tid_t next_tid = 1;
+  enum intr_level old_level;
   tid_t tid;
 
-  lock_acquire(&tid_lock);
+  old_level = intr_disable();
   tid = next_tid++;
-  lock_release(&tid_lock);
+  intr_set_level(old_level);
 
   return tid;
 }
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include "threads/synch.h"
 #include "threads/fixed-point.h"
+#include "threads/fpu.h"
 
 /* States in a thread's life cycle. */
 enum thread_status {
@@ -25,6 +26,10 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63     /* Highest priority. */
 
+/* Thread niceness under the MLFQS scheduler. */
+#define NICE_MIN -20 /* Least nice. */
+#define NICE_MAX 20  /* Most nice. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -87,9 +92,37 @@ struct thread {
   enum thread_status status; /* Thread state. */
   char name[16];             /* Name (for debugging purposes). */
   uint8_t* stack;            /* Saved stack pointer. */
-  int priority;              /* Priority. */
+  int priority;              /* Priority, including donations. */
   struct list_elem allelem;  /* List element for all threads list. */
-  int64_t time;
+  int64_t time;              /* Wake-up time in timer_sleep(), in PIT cycles. */
+
+  /* Priority donation, shared between thread.c and synch.c. */
+  int base_priority;         /* Priority set by thread_set_priority(). */
+  struct lock* waiting_lock; /* Lock this thread is blocked on, if any. */
+  struct list held_locks;    /* Locks this thread holds. */
+
+  /* Multi-level feedback queue scheduler, owned by thread.c. */
+  int nice;                  /* Niceness, from NICE_MIN to NICE_MAX. */
+  fixed_point_t recent_cpu;  /* Decayed count of ticks spent running. */
+
+  /* FIFO scheduler, owned by thread.c. */
+  int cpu; /* CPU whose ready queue the thread joins. */
+
+  /* Stride scheduler, owned by thread.c. */
+  int64_t pass; /* Virtual time; the thread with the least runs next. */
+
+  /* CPU accounting, owned by thread.c. */
+  int64_t run_ticks;         /* Timer ticks spent running. */
+  unsigned voluntary_cnt;    /* Switches away from blocking or yielding. */
+  unsigned involuntary_cnt;  /* Switches away from preemption. */
+  uint64_t ready_since;      /* timer_cycles() when last made ready. */
+  unsigned wait_cnt;         /* Number of ready-queue waits. */
+  uint64_t wait_total;       /* Cycles spent in ready queues. */
+  uint64_t wait_max;         /* Longest ready-queue wait, in cycles. */
+
+  /* Lazy FPU switching, owned by fpu.c. */
+  bool fpu_used;              /* Has the thread used the FPU? */
+  uint8_t fpu[FPU_SAVE_SIZE]; /* FPU state while another thread owns the FPU. */
 
   /* Shared between thread.c and synch.c. */
   struct list_elem elem; /* List element. */
@@ -129,22 +162,33 @@ extern enum sched_policy active_sched_policy;
 
 void thread_init(void);
 void thread_start(void);
+void thread_init_ap(int cpu);
+void thread_start_ap(void) NO_RETURN;
 
-void thread_tick(void);
+void thread_tick(int64_t tick);
 void thread_print_stats(void);
 
+struct threadstat;
+int thread_get_stats(struct threadstat*, int max);
+uint64_t thread_migration_cnt(void);
+
 typedef void thread_func(void* aux);
 tid_t thread_create(const char* name, int priority, thread_func*, void*);
 
 void thread_block(void);
 void thread_unblock(struct thread*);
+void thread_preempt(void);
+void thread_donate_priority(struct thread*);
+void thread_refresh_priority(struct thread*);
 
 struct thread* thread_current(void);
 tid_t thread_tid(void);
 const char* thread_name(void);
+int thread_cpu(void);
 
 void thread_exit(void) NO_RETURN;
 void thread_yield(void);
+void thread_yield_preempted(void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func(struct thread* t, void* aux);
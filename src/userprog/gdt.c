@@ -1,6 +1,7 @@
 #include "userprog/gdt.h"
 #include <debug.h>
 #include "userprog/tss.h"
+#include "threads/mp.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 
@@ -21,8 +22,12 @@
 
    For more information on the GDT as used here, refer to
    [IA32-v3a] 3.2 "Using Segments" through 3.5 "System Descriptor
-   Types". */
-static uint64_t gdt[SEL_CNT];
+   Types".
+
+   Each CPU has its own GDT, which differs from the others only
+   in the TSS descriptor: each CPU has its own TSS, and loading a
+   TSS marks its descriptor busy. */
+static uint64_t gdt[MP_MAX_CPUS][SEL_CNT];
 
 /* GDT helpers. */
 static uint64_t make_code_desc(int dpl);
@@ -30,23 +35,25 @@ static uint64_t make_data_desc(int dpl);
 static uint64_t make_tss_desc(void* laddr);
 static uint64_t make_gdtr_operand(uint16_t limit, void* base);
 
-/* Sets up a proper GDT.  The bootstrap loader's GDT didn't
+/* Sets up a proper GDT for the running CPU, whose TSS must
+   already be initialized.  The bootstrap loader's GDT didn't
    include user-mode selectors or a TSS, but we need both now. */
 void gdt_init(void) {
+  uint64_t* g = gdt[cpu_current()->id];
   uint64_t gdtr_operand;
 
   /* Initialize GDT. */
-  gdt[SEL_NULL / sizeof *gdt] = 0;
-  gdt[SEL_KCSEG / sizeof *gdt] = make_code_desc(0);
-  gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc(0);
-  gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc(3);
-  gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc(3);
-  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc(tss_get());
+  g[SEL_NULL / sizeof *g] = 0;
+  g[SEL_KCSEG / sizeof *g] = make_code_desc(0);
+  g[SEL_KDSEG / sizeof *g] = make_data_desc(0);
+  g[SEL_UCSEG / sizeof *g] = make_code_desc(3);
+  g[SEL_UDSEG / sizeof *g] = make_data_desc(3);
+  g[SEL_TSS / sizeof *g] = make_tss_desc(tss_get());
 
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
      6.2.4 "Task Register".  */
-  gdtr_operand = make_gdtr_operand(sizeof gdt - 1, gdt);
+  gdtr_operand = make_gdtr_operand(sizeof gdt[0] - 1, g);
   asm volatile("lgdt %0" : : "m"(gdtr_operand));
   asm volatile("ltr %w0" : : "q"(SEL_TSS));
 }
@@ -255,7 +255,6 @@ static void start_process(void* arguments) {
     if_.cs = SEL_UCSEG;
     if_.eflags = FLAG_IF | FLAG_MBS;
     /* success: true (1) if load succeed, false (0) if fail */
-    asm volatile("fsave %0" : "=g"(if_.fpu));
     success = load(file_name, &if_.eip, &if_.esp);
   }
   save_data(args->sd_load, success, LOAD);
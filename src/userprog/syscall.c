@@ -2,21 +2,28 @@
 #include "userprog/pagedir.h"
 #include "devices/input.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "filesys/cache.h"
 #include "devices/block.h"
 #include "userprog/syscall.h"
+#include <blktrace.h>
+#include <threadstat.h>
 #include <stdio.h>
 #include <syscall-nr.h>
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "userprog/process.h"
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 #include "threads/vaddr.h"
 #include "filesys/file.h"
 #include <string.h>
 
 struct lock flock;
 static void syscall_handler(struct intr_frame*);
+static void valid_buffer(void* buf, size_t cnt, size_t size);
+static int copy_thread_stats(struct threadstat* ubuf, int max);
 
 /* Initializes the syscall handler. */
 void syscall_init(void) {
@@ -58,6 +65,24 @@ void valid_ptr(void* ptr, size_t i) {
   }
 }
 
+/* Verifies that the array of CNT elements of SIZE bytes each at
+   BUF is fully in userspace, checking every page it touches, and
+   kills the process if it is not or if its size overflows. */
+static void valid_buffer(void* buf, size_t cnt, size_t size) {
+  uintptr_t start = (uintptr_t)buf;
+  uintptr_t end;
+  uintptr_t page;
+
+  if (cnt == 0)
+    return;
+  if (cnt > SIZE_MAX / size || start + cnt * size < start)
+    exit(-1);
+  end = start + cnt * size;
+  for (page = (uintptr_t)pg_round_down(buf); page < end; page += PGSIZE)
+    if (!vaddress((void*)page))
+      exit(-1);
+}
+
 /* Retrieves a file given a file descriptor FD. */
 struct file_map* get_file(int fd) {
   struct file_mappings* file_tbl = thread_current()->pcb->file_list;
@@ -72,6 +97,28 @@ struct file_map* get_file(int fd) {
   return NULL; // Return NULL if the file with the given fd is not found.
 }
 
+/* Copies the CPU accounting of up to MAX threads into user
+   buffer UBUF and returns the number copied, or -1 if MAX is not
+   positive.  The statistics are gathered into a kernel page first,
+   because they must be read with interrupts off, so MAX must not
+   exceed a page's worth; the caller clamps it and validates UBUF. */
+static int copy_thread_stats(struct threadstat* ubuf, int max) {
+  struct threadstat* kbuf;
+  int cnt;
+
+  if (max <= 0)
+    return -1;
+  ASSERT(max <= (int)(PGSIZE / sizeof *kbuf));
+
+  kbuf = palloc_get_page(0);
+  if (kbuf == NULL)
+    return -1;
+  cnt = thread_get_stats(kbuf, max);
+  memcpy(ubuf, kbuf, cnt * sizeof *kbuf);
+  palloc_free_page(kbuf);
+  return cnt;
+}
+
 static void syscall_handler(struct intr_frame* f) {
   uint32_t* args = ((uint32_t*)f->esp);
   valid_ptr((void*)args, sizeof(uint32_t));
@@ -106,9 +153,15 @@ static void syscall_handler(struct intr_frame* f) {
     case SYS_WAIT:
       f->eax = (tid_t)wait((tid_t)args[1]);
       break;
-    case SYS_COMPUTE_E:
+    case SYS_COMPUTE_E: {
+      /* The process's FPU state is still loaded, so set it
+         aside while the kernel computes. */
+      uint8_t fpu[FPU_SAVE_SIZE];
+      fpu_kernel_begin(fpu);
       f->eax = sys_sum_to_e(args[1]);
+      fpu_kernel_end(fpu);
       break;
+    }
     /* Project 2 Synchronization syscalls */
     case SYS_LOCK_INIT:
       lock_init(args[1]);
@@ -147,6 +200,31 @@ static void syscall_handler(struct intr_frame* f) {
     case SYS_BLOCKS_WRITE:
       f->eax = get_write_cnt(fs_device);
       break;
+    case SYS_CLOCK_NS:
+      valid_ptr((void*)args[1], sizeof(uint64_t));
+      *(uint64_t*)args[1] = timer_ns();
+      break;
+    case SYS_BLKTRACE: {
+      int max = args[2];
+      if (max < 0) {
+        f->eax = -1;
+        break;
+      }
+      if (max > BLOCK_TRACE_CNT)
+        max = BLOCK_TRACE_CNT;
+      valid_buffer((void*)args[1], max, sizeof(struct blktrace_entry));
+      f->eax = block_trace_read((struct blktrace_entry*)args[1], max);
+      break;
+    }
+    case SYS_THREADSTAT: {
+      int max = args[2];
+      if (max > (int)(PGSIZE / sizeof(struct threadstat)))
+        max = PGSIZE / sizeof(struct threadstat);
+      if (max > 0)
+        valid_buffer((void*)args[1], max, sizeof(struct threadstat));
+      f->eax = copy_thread_stats((struct threadstat*)args[1], max);
+      break;
+    }
   }
 
   if (args[0] == SYS_READ && args[1] == 0) {
@@ -243,6 +321,9 @@ static void syscall_handler(struct intr_frame* f) {
       f->eax = get_inumber(filemap->file);
     } else if (args[0] == SYS_READDIR) {
       f->eax = dir_readdir((struct dir*)filemap->file, (char*)args[2]);
+    } else if (args[0] == SYS_FSYNC) {
+      cache_sync();
+      f->eax = true;
     }
   }
 }
@@ -2,8 +2,8 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/mp.h"
 #include "threads/thread.h"
-#include "threads/palloc.h"
 #include "threads/vaddr.h"
 
 /* The Task-State Segment (TSS).
@@ -71,29 +71,30 @@ struct tss {
   uint16_t trace, bitmap;
 };
 
-/* Kernel TSS. */
-static struct tss* tss;
+/* Kernel TSS of each CPU.  A TSS holds the kernel stack of the
+   thread its CPU is running, so the CPUs cannot share one. */
+static struct tss tss[MP_MAX_CPUS];
 
-/* Initializes the kernel TSS. */
+/* Initializes the running CPU's kernel TSS. */
 void tss_init(void) {
+  struct tss* t = tss_get();
+
   /* Our TSS is never used in a call gate or task gate, so only a
      few fields of it are ever referenced, and those are the only
      ones we initialize. */
-  tss = palloc_get_page(PAL_ASSERT | PAL_ZERO);
-  tss->ss0 = SEL_KDSEG;
-  tss->bitmap = 0xdfff;
+  t->ss0 = SEL_KDSEG;
+  t->bitmap = 0xdfff;
   tss_update();
 }
 
-/* Returns the kernel TSS. */
-struct tss* tss_get(void) {
-  ASSERT(tss != NULL);
-  return tss;
-}
+/* Returns the running CPU's TSS. */
+struct tss* tss_get(void) { return &tss[cpu_current()->id]; }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
-   of the thread stack. */
+/* Sets the ring 0 stack pointer in the running CPU's TSS to
+   point to the end of the thread stack. */
 void tss_update(void) {
-  ASSERT(tss != NULL);
-  tss->esp0 = (uint8_t*)thread_current() + PGSIZE;
+  struct tss* t = tss_get();
+
+  ASSERT(t->ss0 == SEL_KDSEG);
+  t->esp0 = (uint8_t*)thread_current() + PGSIZE;
 }